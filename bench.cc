@@ -0,0 +1,360 @@
+// Copyright (c) Mike Schaeffer. All rights reserved.
+//
+// The use and distribution terms for this software are covered by the
+// Eclipse Public License 2.0 (https://opensource.org/licenses/EPL-2.0)
+// which can be found in the file LICENSE at the root of this distribution.
+// By using this software in any fashion, you are agreeing to be bound by
+// the terms of this license.
+//
+// You must not remove this notice, or any other, from this software.
+
+/*
+ * bench.cc - Reproducible solver benchmarks
+ * by Michael Schaeffer
+ */
+
+#include <getopt.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "common.h"
+#include "wordtree.h"
+#include "dawg.h"
+#include "boggle_board.h"
+#include "scanner.h"
+
+using namespace std::chrono;
+
+/* Every combination of these is measured. Each board size is solved
+ * the given number of times, with boards drawn from a fixed sequence
+ * of seeds so that every engine sees the same boards in every run. */
+const char *bench_dictionaries[] = { "wordlist-small", "wordlist-large" };
+const int bench_dictionary_count = 2;
+
+const char *bench_engines[] = { "recursive", "recursive-dawg", "iterative",
+                                "lockstep" };
+const int bench_engine_count = 4;
+
+const int bench_sizes[] = { 4, 5, 10, 50 };
+const int bench_boards[] = { 2000, 2000, 500, 50 };
+const int bench_size_count = 4;
+
+int seed = 1;                        // The seed for the first board
+bool json_output = false;            // Write JSON rather than CSV
+
+/* The measurements for one engine and board size against one
+ * dictionary. */
+struct bench_result {
+  int dictionary;
+  int engine;
+  int board_size;
+  int boards;
+  double load_ms;            // Time to make the dictionary usable
+  long peak_rss_kb;          // Of the whole run for this engine
+  double boards_per_sec;
+  double p50_us, p90_us, p99_us, max_us;
+  long words;                // Total words found, to compare engines
+};
+
+char help_text[] = "\n\
+Boggler benchmarks\n\
+by Michael Schaeffer\n\
+\n\
+Usage: boggle_bench [options]\n\
+\n\
+Solves a fixed sequence of random boards at several sizes with each\n\
+search engine, against both of the included word lists, and writes\n\
+one record per engine, dictionary, and board size.\n\
+\n\
+Options:\n\
+\n\
+--json (-j) - Write JSON rather than CSV\n\
+--random-seed=<number> (-r) - Set the seed for the first board\n\
+--help (-h) - Display this help text";
+
+struct option long_options[] = {
+  { "json",        no_argument,       NULL, 'j' },
+  { "random-seed", required_argument, NULL, 'r' },
+  { "help",        no_argument,       NULL, 'h' },
+  { NULL,          0,                 NULL, 0   }
+};
+
+void parse_options(int argc, char *argv[])
+{
+  for(;;) {
+    int option = getopt_long(argc, argv, "jr:h", long_options, NULL);
+
+    if (option == -1)
+      break;
+
+    switch(option) {
+    case 'j':
+      json_output = true;
+      break;
+
+    case 'r':
+      seed = atoi(optarg);
+
+      if (seed <= 0)
+	error("Invalid argument passed for random seed");
+      break;
+
+    default:
+      cout << help_text << endl;
+      exit(0);
+    }
+  }
+}
+
+double elapsed_ms(steady_clock::time_point start)
+{
+  return duration<double, milli>(steady_clock::now() - start).count();
+}
+
+long peak_rss_kb()
+{
+  struct rusage usage;
+
+  getrusage(RUSAGE_SELF, &usage);
+
+  return usage.ru_maxrss;
+}
+
+/* Solve `boards` boards of the given size with `solve`, `group` at a
+ * time, and fill in the timings of `result`. Each board of a group is
+ * taken to have the same share of the time the group took. After each
+ * solve, `collect` returns the number of words found and clears them
+ * away, outside of the timed part. */
+template<class SOLVE, class COLLECT>
+void time_boards(int board_size, int boards, int group, SOLVE solve,
+                 COLLECT collect, bench_result &result)
+{
+  vector<boggle_board> board(group);
+  vector<double> latency_us;
+  double total_us = 0.0;
+
+  for(int i = 0; i < group; i++)
+    board[i].set_size(board_size);
+
+  srand(seed + board_size);
+
+  result.board_size = board_size;
+  result.boards = boards;
+  result.words = 0;
+
+  for(int i = 0; i < boards; i += group) {
+    int count = min(group, boards - i);
+
+    for(int j = 0; j < count; j++)
+      board[j].shuffle();
+
+    steady_clock::time_point start = steady_clock::now();
+
+    solve(board.data(), count);
+
+    double us = duration<double, micro>(steady_clock::now() - start).count();
+
+    result.words += collect(count);
+
+    for(int j = 0; j < count; j++)
+      latency_us.push_back(us / count);
+
+    total_us += us;
+  }
+
+  sort(latency_us.begin(), latency_us.end());
+
+  result.boards_per_sec = boards / (total_us / 1e6);
+  result.p50_us = latency_us[(boards * 50) / 100];
+  result.p90_us = latency_us[(boards * 90) / 100];
+  result.p99_us = latency_us[(boards * 99) / 100];
+  result.max_us = latency_us.back();
+}
+
+/* Load `dictionary` as `engine` needs it, then time every board size
+ * against it, writing the results to the descriptor `out`. This runs
+ * in a process of its own, so that its peak RSS is its own too. */
+void bench_engine(int dictionary, int engine, int out)
+{
+  const char *engine_name = bench_engines[engine];
+  wordtree words, found;
+  dawg graph;
+  word_set found_ids;
+  vector<word_set> group_ids(boggle_board::GROUP_LANES);
+  scanner in;
+
+  steady_clock::time_point start = steady_clock::now();
+
+  if (!in.open(bench_dictionaries[dictionary]) || !(in >> words))
+    error("Error reading file.");
+
+  in.close();
+
+  if (strcmp(engine_name, "recursive") != 0) {
+    graph.build(words);
+    words.clear();
+    found_ids.set_word_count(graph.word_count());
+
+    for(int i = 0; i < boggle_board::GROUP_LANES; i++)
+      group_ids[i].set_word_count(graph.word_count());
+  }
+
+  double load_ms = elapsed_ms(start);
+
+  for(int size = 0; size < bench_size_count; size++) {
+    bench_result result;
+
+    result.dictionary = dictionary;
+    result.engine = engine;
+    result.load_ms = load_ms;
+
+    auto collect_found = [&](int) {
+      long count = found.word_count();
+      found.clear();
+      return count;
+    };
+
+    if (strcmp(engine_name, "recursive") == 0)
+      time_boards(bench_sizes[size], bench_boards[size], 1,
+                  [&](boggle_board *board, int) {
+                    board->find_words(words, found);
+                  },
+                  collect_found, result);
+    else if (strcmp(engine_name, "recursive-dawg") == 0)
+      time_boards(bench_sizes[size], bench_boards[size], 1,
+                  [&](boggle_board *board, int) {
+                    board->find_words(graph, found);
+                  },
+                  collect_found, result);
+    else if (strcmp(engine_name, "iterative") == 0)
+      time_boards(bench_sizes[size], bench_boards[size], 1,
+                  [&](boggle_board *board, int) {
+                    board->search_words(graph, found_ids);
+                  },
+                  [&](int) {
+                    long count = found_ids.size();
+                    found_ids.clear();
+                    return count;
+                  },
+                  result);
+    else
+      time_boards(bench_sizes[size], bench_boards[size],
+                  boggle_board::GROUP_LANES,
+                  [&](boggle_board *board, int count) {
+                    boggle_board::search_group(graph, board,
+                                               group_ids.data(), count);
+                  },
+                  [&](int boards) {
+                    long count = 0;
+
+                    for(int i = 0; i < boards; i++) {
+                      count += group_ids[i].size();
+                      group_ids[i].clear();
+                    }
+
+                    return count;
+                  },
+                  result);
+
+    result.peak_rss_kb = peak_rss_kb();
+
+    if (write(out, &result, sizeof(result)) != sizeof(result))
+      error("Error writing benchmark results.");
+  }
+}
+
+void write_result(bench_result &r, bool first)
+{
+  const char *dictionary = bench_dictionaries[r.dictionary];
+  const char *engine = bench_engines[r.engine];
+
+  if (json_output) {
+    cout << (first ? "[\n" : ",\n")
+         << "  {\"dictionary\": \"" << dictionary << "\""
+         << ", \"engine\": \"" << engine << "\""
+         << ", \"board_size\": " << r.board_size
+         << ", \"boards\": " << r.boards
+         << ", \"load_ms\": " << r.load_ms
+         << ", \"peak_rss_kb\": " << r.peak_rss_kb
+         << ", \"boards_per_sec\": " << r.boards_per_sec
+         << ", \"p50_us\": " << r.p50_us
+         << ", \"p90_us\": " << r.p90_us
+         << ", \"p99_us\": " << r.p99_us
+         << ", \"max_us\": " << r.max_us
+         << ", \"words\": " << r.words << "}";
+    return;
+  }
+
+  if (first)
+    cout << "dictionary,engine,board_size,boards,load_ms,peak_rss_kb,"
+         << "boards_per_sec,p50_us,p90_us,p99_us,max_us,words\n";
+
+  cout << dictionary << ',' << engine << ','
+       << r.board_size << ',' << r.boards << ','
+       << r.load_ms << ',' << r.peak_rss_kb << ','
+       << r.boards_per_sec << ','
+       << r.p50_us << ',' << r.p90_us << ',' << r.p99_us << ','
+       << r.max_us << ',' << r.words << '\n';
+}
+
+/* Run each engine against each dictionary in a child process, and
+ * write the records they send back. */
+int main(int argc, char *argv[])
+{
+  bool first = true;
+
+  parse_options(argc, argv);
+
+  for(int dictionary = 0; dictionary < bench_dictionary_count; dictionary++)
+    for(int engine = 0; engine < bench_engine_count; engine++) {
+      int fds[2];
+
+      if (pipe(fds) < 0)
+        error("Error creating benchmark pipe.");
+
+      cout.flush();
+
+      pid_t child = fork();
+
+      if (child < 0)
+        error("Error starting benchmark.");
+
+      if (child == 0) {
+        close(fds[0]);
+        bench_engine(dictionary, engine, fds[1]);
+        close(fds[1]);
+        _exit(0);
+      }
+
+      close(fds[1]);
+
+      bench_result result;
+
+      while (read(fds[0], &result, sizeof(result)) == sizeof(result)) {
+        write_result(result, first);
+        first = false;
+      }
+
+      close(fds[0]);
+
+      int status;
+
+      if ((waitpid(child, &status, 0) < 0)
+          || !WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+        error("Benchmark run failed.");
+    }
+
+  if (json_output)
+    cout << (first ? "[]" : "\n]") << endl;
+
+  cout.flush();
+
+  return 0;
+}
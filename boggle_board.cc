@@ -15,10 +15,18 @@
 
 
 #include <assert.h>
+#include <string.h>
+
+#include <algorithm>
+#include <mutex>
 
 #include "common.h"
 #include "wordtree.h"
+#include "dawg.h"
+#include "thread_pool.h"
 #include "boggle_board.h"
+#include "scanner.h"
+#include "score.h"
 
 /* Boggle Cube definitions.  These strings contain the letters
  * present on a set of boggle cubes.  Each string represents one
@@ -32,17 +40,36 @@ const char *boggle_cubes [] = {
   "mgaeeu", "toutoo", "spriyf", "rlhhod", "gworru" 
 };
 
+/* The offsets to each of a cell's eight neighbors, in the order
+ * find_words_at visits them. */
+static const int neighbor_dx[8] = {  0,  1,  1,  1,  0, -1, -1, -1 };
+static const int neighbor_dy[8] = { -1, -1,  0,  1,  1,  1,  0, -1 };
 
 boggle_board::boggle_board() {
   _board = NULL;
   _marks = NULL;
 
+  _cell_count = 0;
+  _cell_offset = NULL;
+  _neighbors = NULL;
+  _neighbor_count = NULL;
+  _letters = NULL;
+  _neighbor_letters = NULL;
+
+  _stats = NULL;
+
   set_size(5);
 }
 
 boggle_board::~boggle_board() {
-  delete _board;
-  delete _marks;
+  delete [] _board;
+  delete [] _marks;
+
+  delete [] _cell_offset;
+  delete [] _neighbors;
+  delete [] _neighbor_count;
+  delete [] _letters;
+  delete [] _neighbor_letters;
 }
 
 void boggle_board::set_size(int size) {
@@ -50,35 +77,84 @@ void boggle_board::set_size(int size) {
 }
 
 /*
- * Reset the board to the specified size.
+ * Reset the board to the specified size. The cell storage is only
+ * reallocated if the size actually changes, so that reloading a
+ * board of the same size is cheap.
  */
 void boggle_board::set_size(int xsize, int ysize) {
   int i, j;
 
-  delete _board;
-  delete _marks;
+  if (!_board || (xsize != _xsize) || (ysize != _ysize)) {
+    delete [] _board;
+    delete [] _marks;
+
+    _xsize = xsize;
+    _ysize = ysize;
 
-  _xsize = xsize;
-  _ysize = ysize;
+    _board = new char[(_xsize + 2) * (_ysize + 2)];
+    _marks = new bool[(_xsize + 2) * (_ysize + 2)];
 
-  _board = new char[(_xsize + 2) * (_ysize + 2)];
-  _marks = new bool[(_xsize + 2) * (_ysize + 2)];
+    release_neighbors();
+    _cell_count = _xsize * _ysize;
+  }
 
+  // The board is surrounded by a border of marked cells, so searches
+  // never need to check for running off the edge.
   for(i = 0; i < _xsize + 2; i++)
     for(j = 0; j < _ysize + 2; j++) {
       set(i, j, '*');
-      unmark(i, j);
+
+      if ((i == 0) || (i == _xsize + 1) || (j == 0) || (j == _ysize + 1))
+        mark(i, j);
+      else
+        unmark(i, j);
     }
+}
 
-  for(i = 0; i < _xsize; i++) {
-      mark(i, 0);
-      mark(i, _ysize);
-  }
+/* Drop the tables of neighbors, which no longer fit the board. They
+ * take several times the space of the board itself, so a board that's
+ * only ever searched a tile at a time never builds them. */
+void boggle_board::release_neighbors() {
+  delete [] _cell_offset;
+  delete [] _neighbors;
+  delete [] _neighbor_count;
+  delete [] _letters;
+  delete [] _neighbor_letters;
 
-  for(i = 0; i < _ysize; i++) {
-      mark(0, i);
-      mark(_xsize, i);
-  }
+  _cell_offset = NULL;
+  _neighbors = NULL;
+  _neighbor_count = NULL;
+  _letters = NULL;
+  _neighbor_letters = NULL;
+}
+
+/* Number the cells inside the border, and record each one's
+ * neighbors, for use by search_words. */
+void boggle_board::set_neighbors() {
+  _cell_offset = new int[_cell_count];
+  _neighbors = new int[_cell_count * 8];
+  _neighbor_count = new int[_cell_count];
+  _letters = new uint8_t[_cell_count];
+  _neighbor_letters = new uint32_t[_cell_count];
+
+  _search.set_cell_count(_cell_count);
+
+  for(int x = 1; x <= _xsize; x++)
+    for(int y = 1; y <= _ysize; y++) {
+      int cell = (x - 1) + (y - 1) * _xsize;
+
+      _cell_offset[cell] = cell_index(x, y);
+      _neighbor_count[cell] = 0;
+
+      for(int i = 0; i < 8; i++) {
+        int nx = x + neighbor_dx[i];
+        int ny = y + neighbor_dy[i];
+
+        if ((nx >= 1) && (nx <= _xsize) && (ny >= 1) && (ny <= _ysize))
+          _neighbors[cell * 8 + _neighbor_count[cell]++]
+            = (nx - 1) + (ny - 1) * _xsize;
+      }
+    }
 }
 
 /*
@@ -91,56 +167,71 @@ void boggle_board::set_size(int xsize, int ysize) {
  * algorithm.
  */
 void boggle_board::shuffle() {
+  fill_random(limited_random);
+}
+
+/* Fill the board as shuffle() does, drawing numbers from `random`
+ * rather than rand(). */
+void boggle_board::shuffle(counter_random &random) {
+  fill_random([&](int limit) { return random.limited(limit); });
+}
+
+/* Fill the board from boggle_cubes, or with random letters if it has
+ * more than 25 cells, using `random(limit)` for numbers in [0,
+ * limit). The cubes are dealt to the cells by a Fisher-Yates shuffle,
+ * so each cell takes one draw. */
+template<class RANDOM>
+void boggle_board::fill_random(RANDOM random) {
   if (_xsize * _ysize <= 25) {
-       bool cube_used[25];
+    int cubes[25];
 
     for(int i = 0; i < 25; i++)
-         cube_used[i] = false;
+      cubes[i] = i;
+
+    int dealt = 0;
 
     for(int i = 1; i <= _xsize; i++)
       for(int j = 1; j <= _ysize; j++) {
+        int pick = dealt + random(25 - dealt);
+        int cube = cubes[pick];
 
-	while(1) {
-	  int cube = limited_random(25);
+        cubes[pick] = cubes[dealt];
+        cubes[dealt++] = cube;
 
-	  if (!cube_used[cube]) {
-	    set(i, j, boggle_cubes[cube][limited_random(6)]);
-        cube_used[cube] = true;
-	  break;
-	  }
-	}
-      };
+        set(i, j, boggle_cubes[cube][random(6)]);
+      }
   } else {
     for(int i = 1; i <= _xsize; i++)
       for(int j = 1; j <= _ysize; j++)
-	set(i, j, 'a' + limited_random(26));
+	set(i, j, 'a' + random(26));
   }
 }
 
+/* Return the offset of the cell at (x, y) within _board and _marks,
+ * which are laid out row by row including the border. */
+int boggle_board::cell_index(int x, int y) {
+  assert((x >= 0) && (x <= _xsize + 1) && (y >= 0) && (y <= _ysize + 1));
+  return x + y * (_xsize + 2);
+}
 
 char boggle_board::ref(int x, int y) {
-  assert((x >= 0) && (x <= _xsize + 1) && (y >= 0) && (y <= _ysize + 1));
-  return _board[x + y * _xsize];
+  return _board[cell_index(x, y)];
 }
 
 void boggle_board::set(int x, int y, char ch) {
-  assert((x >= 0) && (x <= _xsize + 1) && (y >= 0) && (y <= _ysize + 1));
-  _board[x + y * _xsize] = ch;
+  _board[cell_index(x, y)] = ch;
 }
 
 bool boggle_board::is_marked(int x, int y) {
-  assert((x >= 0) && (x <= _xsize + 1) && (y >= 0) && (y <= _ysize + 1));
-  return _marks[x + y * _xsize];
+  return _marks[cell_index(x, y)];
 };
 
 void boggle_board::mark(int x, int y) {
-  assert((x >= 0) && (x <= _xsize + 1) && (y >= 0) && (y <= _ysize + 1));
-  _marks[x + y * _xsize] = true;
+  _marks[cell_index(x, y)] = true;
 };
 
 void boggle_board::unmark(int x, int y) {
-  assert((x >= 0) && (x <= _xsize + 1) && (y >= 0) && (y <= _ysize + 1));
-  _marks[x + y * _xsize] = false;
+  _marks[cell_index(x, y)] = false;
 };
 
 int boggle_board::xsize() {
@@ -151,63 +242,900 @@ int boggle_board::ysize() {
   return _ysize;
 };
 
-/* Recursive step for breadth-first word search. */
+/* Have later searches add their counters to `stats`, or, if it's
+ * NULL, stop keeping counters. */
+void boggle_board::set_stats(search_stats *stats) {
+  _stats = stats;
+}
+
+search_stats::search_stats() {
+  clear();
+}
+
+void search_stats::clear() {
+  _nodes_visited = 0;
+  _branches_pruned = 0;
+  _word_hits = 0;
+  _max_depth = 0;
+  _depth = 0;
+
+  fill(_node_visits.begin(), _node_visits.end(), 0);
+}
+
+void search_stats::add(search_stats &other) {
+  _nodes_visited += other._nodes_visited;
+  _branches_pruned += other._branches_pruned;
+  _word_hits += other._word_hits;
+
+  if (other._max_depth > _max_depth)
+    _max_depth = other._max_depth;
+
+  for(size_t i = 0; (i < _node_visits.size()) && (i < other._node_visits.size()); i++)
+    _node_visits[i] += other._node_visits[i];
+}
+
+/* Recursive step for breadth-first word search. 'marks' records the
+ * cells already used by the current path. If 'stats' isn't NULL, the
+ * search keeps its counters there. The neighbors are only visited if
+ * one of them holds a letter that continues a word, which is a single
+ * test of the dictionary's letters against _neighbor_letters. */
+template<class ITER>
 void boggle_board::find_words_at(int xloc,
                                  int yloc,
-                                 wordtree::iterator wl_location,
-                                 wordtree &words)
+                                 ITER wl_location,
+                                 bool *marks,
+                                 wordtree &words,
+                                 search_stats *stats)
 {
   if (wl_location.is_word())
     words.insert_word(wl_location());
 
-  if (!is_marked(xloc, yloc)) {
-    char ch = ref(xloc, yloc);
+  int cell = cell_index(xloc, yloc);
+
+  if (!marks[cell]) {
+    char ch = _board[cell];
 
     if(wl_location.letter_exists(ch)) {
-      mark(xloc, yloc);
+      marks[cell] = true;
 
-      wordtree::iterator new_loc = wl_location.letter(ref(xloc, yloc));
+      ITER new_loc = wl_location.letter(ch);
 
-      find_words_at(xloc    , yloc - 1, new_loc, words);
-      find_words_at(xloc + 1, yloc - 1, new_loc, words);
-      find_words_at(xloc + 1, yloc    , new_loc, words);
-      find_words_at(xloc + 1, yloc + 1, new_loc, words);
-      find_words_at(xloc    , yloc + 1, new_loc, words);
-      find_words_at(xloc - 1, yloc + 1, new_loc, words);
-      find_words_at(xloc - 1, yloc    , new_loc, words);
-      find_words_at(xloc - 1, yloc - 1, new_loc, words);
+      if (stats)
+        stats->enter(new_loc.is_word());
 
-      unmark(xloc, yloc);
-    }
+      // Without counters to keep, the neighbors needn't be visited
+      // one by one just to find that none of them continues a word.
+      if (stats || (new_loc.letters()
+                    & _neighbor_letters[(xloc - 1) + (yloc - 1) * _xsize])) {
+        for(int i = 0; i < 8; i++)
+          find_words_at(xloc + neighbor_dx[i], yloc + neighbor_dy[i],
+                        new_loc, marks, words, stats);
+      } else if (new_loc.is_word())
+        words.insert_word(new_loc());
+
+      if (stats)
+        stats->leave();
+
+      marks[cell] = false;
+    } else if (stats)
+      stats->_branches_pruned++;
   }
 };
 
+/* Search the paths that start at (xloc, yloc) and continue through
+ * the neighbor in `direction`. Together, the eight directions cover
+ * the same paths as a call to find_words_at at the root. The start
+ * cell itself is only counted in 'stats' by direction 0, so that it
+ * isn't counted eight times over. */
+template<class ITER>
+void boggle_board::find_words_toward(int xloc,
+                                     int yloc,
+                                     int direction,
+                                     ITER wl_location,
+                                     bool *marks,
+                                     wordtree &words,
+                                     search_stats *stats)
+{
+  int cell = cell_index(xloc, yloc);
+  char ch = _board[cell];
+
+  if (marks[cell])
+    return;
+
+  if (!wl_location.letter_exists(ch)) {
+    if (stats && (direction == 0))
+      stats->_branches_pruned++;
+
+    return;
+  }
+
+  marks[cell] = true;
+
+  ITER new_loc = wl_location.letter(ch);
+
+  if (stats) {
+    if (direction == 0)
+      stats->enter(new_loc.is_word());
+    else
+      stats->_depth++;
+  }
+
+  find_words_at(xloc + neighbor_dx[direction],
+                yloc + neighbor_dy[direction],
+                new_loc, marks, words, stats);
+
+  if (stats)
+    stats->leave();
+
+  marks[cell] = false;
+}
+
 /* Search the board for the words contained in 'dict', loading each
- * found word into 'found_words'.
+ * found word into 'found_words'. 'dict' may be any dictionary that
+ * provides an iterator with the interface of wordtree::iterator.
  */
-void boggle_board::find_words(wordtree &dict, wordtree &found_words)
+template<class DICT>
+void boggle_board::find_words(DICT &dict, wordtree &found_words)
 {
+  prepare_search();
+
   for (int xloc = 1; xloc <= _xsize; xloc++) 
     for (int yloc = 1; yloc <= _ysize; yloc++) 
-      find_words_at(xloc, yloc, wordtree::iterator(dict), found_words);
+      find_words_at(xloc, yloc, typename DICT::iterator(dict), _marks,
+                    found_words, _stats);
+};
+
+/* Search the board for the words in 'dict' using every thread in
+ * 'pool'. The search is split into one task per starting cell and
+ * first step, and tasks are handed out as threads come free, so a
+ * dense corner of the board doesn't leave the other threads idle.
+ * Each thread has its own marks and result set, and the result sets
+ * are merged once the search is done.
+ */
+template<class DICT>
+void boggle_board::find_words(DICT &dict,
+                              wordtree &found_words,
+                              thread_pool &pool)
+{
+  int workers = pool.thread_count();
+
+  if (workers == 1) {
+    find_words(dict, found_words);
+    return;
+  }
+
+  prepare_search();
+
+  int cells = (_xsize + 2) * (_ysize + 2);
+  bool *worker_marks = new bool[workers * cells];
+  wordtree *worker_words = new wordtree[workers];
+  search_stats *worker_stats = new search_stats[workers];
+
+  for(int i = 0; i < workers; i++)
+    memcpy(worker_marks + i * cells, _marks, cells * sizeof(bool));
+
+  pool.run(_xsize * _ysize * 8, [&](int worker, int task) {
+      int start = task / 8;
+
+      find_words_toward(1 + start % _xsize, 1 + start / _xsize, task % 8,
+                        typename DICT::iterator(dict),
+                        worker_marks + worker * cells,
+                        worker_words[worker],
+                        _stats ? &worker_stats[worker] : NULL);
+    });
+
+  for(int i = 0; i < workers; i++) {
+    found_words.insert_words(worker_words[i]);
+
+    if (_stats)
+      _stats->add(worker_stats[i]);
+  }
+
+  delete [] worker_stats;
+  delete [] worker_words;
+  delete [] worker_marks;
+}
+
+boggle_board::search_state::search_state() {
+  _visited = NULL;
+}
+
+boggle_board::search_state::~search_state() {
+  delete [] _visited;
+}
+
+/* Size the visited set for a board of `cell_count` cells, one bit
+ * per cell. */
+void boggle_board::search_state::set_cell_count(int cell_count) {
+  delete [] _visited;
+
+  int words = (cell_count + 63) / 64;
+
+  _visited = new uint64_t[words];
+
+  for(int i = 0; i < words; i++)
+    _visited[i] = 0;
+}
+
+/* Load each cell's letter into _letters, as a letter index for the
+ * dawg, and the set of letters around it into _neighbor_letters.
+ * Cells that don't hold a lower case letter get an index that
+ * matches no edge. The letters on the whole board, and those on it
+ * more than once, go into _board_letters and _board_doubled. */
+void boggle_board::prepare_search() {
+  if (_cell_offset == NULL)
+    set_neighbors();
+
+  _board_letters = 0;
+  _board_doubled = 0;
+
+  for(int cell = 0; cell < _cell_count; cell++) {
+    char ch = _board[_cell_offset[cell]];
+
+    _letters[cell] = ((ch >= 'a') && (ch <= 'z')) ? ch - 'a' : 26;
+
+    _board_doubled |= _board_letters & (1 << _letters[cell]);
+    _board_letters |= 1 << _letters[cell];
+  }
+
+  for(int cell = 0; cell < _cell_count; cell++) {
+    _neighbor_letters[cell] = 0;
+
+    for(int i = 0; i < _neighbor_count[cell]; i++)
+      _neighbor_letters[cell] |= 1 << _letters[_neighbors[cell * 8 + i]];
+  }
+}
+
+/* Return false if no word below `edge` can be spelled with the
+ * letters on the board. Letters are counted over the whole board, not
+ * just the cells a path has left, so this never skips a word that's
+ * there. */
+inline bool boggle_board::can_follow(dawg &dict, uint32_t edge)
+{
+  return dict.edge_fits(edge, _board_letters, _board_doubled);
+}
+
+/* Find every word in 'dict' along a path starting at `start`. This
+ * is the same search as find_words_at, but it keeps its own stack of
+ * frames instead of recursing, tracks the cells in use with a
+ * bitmask, and records each word found by its dawg id, which it
+ * works out along the way. No strings are built, and nothing is
+ * allocated.
+ *
+ * Each frame walks the edges out of its dictionary node, and for each
+ * edge, the unvisited neighbors holding that edge's letter. Deep in
+ * the dictionary most nodes have only an edge or two, and edges whose
+ * letter isn't next to the cell at all are skipped with a single
+ * test, so this does far less work than looking up each neighbor's
+ * letter in turn. Edges are also skipped if every word below them
+ * needs a letter the board doesn't have, or has only once where the
+ * words need it twice. Each word found is passed to found.add(), along
+ * with its length. 'state' must have an empty visited set, and is left
+ * that way. If 'stats' isn't NULL, the search keeps its counters
+ * there, counting the same things find_words_at does.
+ */
+template<class FOUND>
+void boggle_board::search_from(int start,
+                               dawg &dict,
+                               search_state &state,
+                               FOUND &found,
+                               search_stats *stats)
+{
+  uint64_t *visited = state._visited;
+  search_frame *stack = state._stack;
+
+  uint32_t root = dict.root();
+  uint32_t edge;
+
+  for(edge = dict.first_edge(root); edge < dict.end_edge(root); edge++)
+    if (dict.edge_letter(edge) == _letters[start])
+      break;
+
+  if (stats)
+    stats->visit(root);
+
+  if ((edge == dict.end_edge(root)) || !can_follow(dict, edge)) {
+    if (stats)
+      stats->_branches_pruned++;
+
+    return;
+  }
+
+  uint32_t node = dict.edge_target(edge);
+  int depth = 1;
+
+  stack[0]._cell = start;
+  stack[0]._edge = dict.first_edge(node);
+  stack[0]._end_edge = dict.end_edge(node);
+  stack[0]._word_id = dict.edge_word_offset(edge);
+  stack[0]._next_neighbor = 0;
+  visited[start / 64] |= 1ULL << (start % 64);
+
+  if (dict.is_word(node))
+    found.add(stack[0]._word_id, 1);
+
+  if (stats) {
+    stats->enter(dict.is_word(node));
+    stats->visit(node);
+    count_pruned(start, node, dict, visited, stats);
+  }
+
+  while (depth > 0) {
+    search_frame &frame = stack[depth - 1];
+    int next_cell = -1;
+
+    // Find the next unvisited neighbor that continues a word.
+    while (frame._edge < frame._end_edge) {
+      int letter = dict.edge_letter(frame._edge);
+
+      if ((_neighbor_letters[frame._cell] & (1 << letter))
+          && can_follow(dict, frame._edge)) {
+        int *neighbors = _neighbors + frame._cell * 8;
+
+        while (frame._next_neighbor < _neighbor_count[frame._cell]) {
+          int cell = neighbors[frame._next_neighbor++];
+
+          if ((_letters[cell] == letter)
+              && !(visited[cell / 64] & (1ULL << (cell % 64)))) {
+            next_cell = cell;
+            break;
+          }
+        }
+
+        if (next_cell >= 0)
+          break;
+      }
+
+      frame._edge++;
+      frame._next_neighbor = 0;
+    }
+
+    if (next_cell < 0) {
+      visited[frame._cell / 64] &= ~(1ULL << (frame._cell % 64));
+      depth--;
+
+      if (stats)
+        stats->leave();
+
+      continue;
+    }
+
+    if (depth == MAX_WORD_SIZE - 1)
+      continue;
+
+    node = dict.edge_target(frame._edge);
+
+    stack[depth]._cell = next_cell;
+    stack[depth]._edge = dict.first_edge(node);
+    stack[depth]._end_edge = dict.end_edge(node);
+    stack[depth]._word_id = frame._word_id + dict.edge_word_offset(frame._edge);
+    stack[depth]._next_neighbor = 0;
+    visited[next_cell / 64] |= 1ULL << (next_cell % 64);
+
+    if (dict.is_word(node))
+      found.add(stack[depth]._word_id, depth + 1);
+
+    if (stats) {
+      stats->enter(dict.is_word(node));
+      stats->visit(node);
+      count_pruned(next_cell, node, dict, visited, stats);
+    }
+
+    depth++;
+  }
+}
+
+/* Count the unvisited neighbors of `cell` that the search won't step
+ * onto, because no word continues from `node` with their letter, or
+ * none that does can be spelled with the letters on the board. The
+ * search itself never looks at them one by one, so this is only done
+ * when keeping counters. */
+void boggle_board::count_pruned(int cell,
+                                uint32_t node,
+                                dawg &dict,
+                                uint64_t *visited,
+                                search_stats *stats)
+{
+  for(int i = 0; i < _neighbor_count[cell]; i++) {
+    int neighbor = _neighbors[cell * 8 + i];
+
+    if (visited[neighbor / 64] & (1ULL << (neighbor % 64)))
+      continue;
+
+    uint32_t edge;
+
+    for(edge = dict.first_edge(node); edge < dict.end_edge(node); edge++)
+      if (dict.edge_letter(edge) == _letters[neighbor])
+        break;
+
+    if ((edge == dict.end_edge(node)) || !can_follow(dict, edge))
+      stats->_branches_pruned++;
+  }
+}
+
+/* Collects the words found by search_from in a word_set. */
+struct id_collector {
+  word_set &_words;
+
+  id_collector(word_set &words) : _words(words) { }
+
+  void add(uint32_t id, int length) { _words.add(id); }
+};
+
+/* Adds up the score of the words found by search_from, as they're
+ * found, counting each word only once. */
+struct score_collector {
+  word_set &_words;
+  score_table &_scores;
+  int _score;
+
+  score_collector(word_set &words, score_table &scores)
+    : _words(words), _scores(scores), _score(0) { }
+
+  void add(uint32_t id, int length)
+  {
+    if (_words.add(id))
+      _score += _scores.score(length);
+  }
+};
+
+/* Search the board for the words contained in 'dict', adding each
+ * one found to 'found_words', using the iterative search. This finds
+ * the same words as find_words. 'found_words' must already be sized
+ * for 'dict'. */
+void boggle_board::search_words(dawg &dict, word_set &found_words)
+{
+  id_collector found(found_words);
+
+  prepare_search();
+
+  for(int start = 0; start < _cell_count; start++)
+    search_from(start, dict, _search, found, _stats);
+}
+
+/* Search the board as search_words does, and return the total score
+ * of the words found under 'scores'. Each word is scored as it's
+ * found, by the length of the path that spelled it, so no word is
+ * ever turned back into a string. 'found_words' still collects the
+ * ids, which is what keeps a word from scoring twice, and its size()
+ * is the number of words found. */
+int boggle_board::score_words(dawg &dict,
+                              word_set &found_words,
+                              score_table &scores)
+{
+  score_collector found(found_words, scores);
+
+  prepare_search();
+
+  for(int start = 0; start < _cell_count; start++)
+    search_from(start, dict, _search, found, _stats);
+
+  return found._score;
+}
+
+/* Search the board for the words in 'dict' using every thread in
+ * 'pool', with one task per starting cell. */
+void boggle_board::search_words(dawg &dict,
+                                word_set &found_words,
+                                thread_pool &pool)
+{
+  int workers = pool.thread_count();
+
+  if (workers == 1) {
+    search_words(dict, found_words);
+    return;
+  }
+
+  search_state *worker_state = new search_state[workers];
+  word_set *worker_words = new word_set[workers];
+  search_stats *worker_stats = new search_stats[workers];
+
+  for(int i = 0; i < workers; i++) {
+    worker_state[i].set_cell_count(_cell_count);
+    worker_words[i].set_word_count(dict.word_count());
+  }
+
+  prepare_search();
+
+  pool.run(_cell_count, [&](int worker, int start) {
+      id_collector found(worker_words[worker]);
+
+      search_from(start, dict, worker_state[worker], found,
+                  _stats ? &worker_stats[worker] : NULL);
+    });
+
+  for(int i = 0; i < workers; i++) {
+    found_words.add(worker_words[i]);
+
+    if (_stats)
+      _stats->add(worker_stats[i]);
+  }
+
+  delete [] worker_stats;
+  delete [] worker_words;
+  delete [] worker_state;
+}
+
+/* Search only the paths that start in the `xsize` by `ysize` cells
+ * from (x, y), adding the words found to 'found_words'. */
+void boggle_board::search_region(dawg &dict,
+                                 word_set &found_words,
+                                 int x, int y, int xsize, int ysize)
+{
+  id_collector found(found_words);
+
+  prepare_search();
+
+  for(int i = x; i < x + xsize; i++)
+    for(int j = y; j < y + ysize; j++)
+      search_from((i - 1) + (j - 1) * _xsize, dict, _search, found, _stats);
+}
+
+/* Search a board too big to search in one piece, such as one of a
+ * million cells, a square tile of `tile_size` cells on a side at a
+ * time, across the threads in 'pool'.
+ *
+ * No path is longer than the longest word, so every path starting in
+ * a tile stays within a halo of that many cells less one around it.
+ * Each thread copies its tile and the halo into a board of its own,
+ * and searches only the paths starting in the tile. The search itself
+ * then never needs more than a tile's worth of space per thread,
+ * whatever the size of the board.
+ *
+ * As each tile is finished, the words it found that are new to
+ * 'found_words' are added to it and passed to `fn`, so results can be
+ * written out as the search goes. The calls to `fn` are made one at a
+ * time, from whichever thread finished the tile.
+ */
+void boggle_board::search_tiles(dawg &dict,
+                                word_set &found_words,
+                                int tile_size,
+                                thread_pool &pool,
+                                const found_fn &fn)
+{
+  int workers = pool.thread_count();
+  int halo = dict.longest_word() - 1;
+  int xtiles = (_xsize + tile_size - 1) / tile_size;
+  int ytiles = (_ysize + tile_size - 1) / tile_size;
+
+  if (halo > MAX_WORD_SIZE - 2)
+    halo = MAX_WORD_SIZE - 2;
+
+  if (halo < 0)
+    halo = 0;
+
+  boggle_board *worker_board = new boggle_board[workers];
+  word_set *worker_words = new word_set[workers];
+  size_t *worker_reported = new size_t[workers];
+  search_stats *worker_stats = new search_stats[workers];
+  mutex found_lock;
+
+  for(int i = 0; i < workers; i++) {
+    worker_words[i].set_word_count(dict.word_count());
+    worker_reported[i] = 0;
+
+    if (_stats)
+      worker_board[i].set_stats(&worker_stats[i]);
+  }
+
+  pool.run(xtiles * ytiles, [&](int worker, int task) {
+      boggle_board &tile = worker_board[worker];
+      word_set &words = worker_words[worker];
+
+      // The tile, and the halo around it, clipped to the board
+      int x0 = 1 + (task / ytiles) * tile_size;
+      int y0 = 1 + (task % ytiles) * tile_size;
+      int x1 = min(x0 + tile_size - 1, _xsize);
+      int y1 = min(y0 + tile_size - 1, _ysize);
+      int hx0 = max(x0 - halo, 1), hx1 = min(x1 + halo, _xsize);
+      int hy0 = max(y0 - halo, 1), hy1 = min(y1 + halo, _ysize);
+
+      tile.set_size(hx1 - hx0 + 1, hy1 - hy0 + 1);
+
+      for(int x = hx0; x <= hx1; x++)
+        for(int y = hy0; y <= hy1; y++)
+          tile.set(x - hx0 + 1, y - hy0 + 1, ref(x, y));
+
+      tile.search_region(dict, words, x0 - hx0 + 1, y0 - hy0 + 1,
+                         x1 - x0 + 1, y1 - y0 + 1);
+
+      // The thread's own set already keeps it from reporting a word
+      // twice, so only its words since the last tile need checking.
+      vector<uint32_t> &ids = words.ids();
+      vector<uint32_t> fresh;
+      unique_lock<mutex> guard(found_lock);
+
+      for(size_t i = worker_reported[worker]; i < ids.size(); i++)
+        if (found_words.add(ids[i]))
+          fresh.push_back(ids[i]);
+
+      worker_reported[worker] = ids.size();
+
+      if (!fresh.empty())
+        fn(fresh);
+    });
+
+  if (_stats)
+    for(int i = 0; i < workers; i++)
+      _stats->add(worker_stats[i]);
+
+  delete [] worker_stats;
+  delete [] worker_reported;
+  delete [] worker_words;
+  delete [] worker_board;
+}
+
+/* A cell bitmap for each board of a group searched by search_group,
+ * one board to a lane. The compiler spreads the lanes across as wide
+ * a vector unit as the target has, or handles them one at a time on a
+ * target without one. */
+typedef uint32_t lane_bits
+  __attribute__((vector_size(4 * boggle_board::GROUP_LANES)));
+
+static inline bool any_lane(const lane_bits &bits)
+{
+  uint32_t any = 0;
+
+  for(int lane = 0; lane < boggle_board::GROUP_LANES; lane++)
+    any |= bits[lane];
+
+  return any != 0;
+}
+
+/* One level of search_group's walk of the dictionary. `_reach` holds,
+ * in each lane, the cells a path spelling the prefix so far can end
+ * on, and `_next` the cells next to them. */
+struct group_frame {
+  lane_bits _reach;
+  lane_bits _next;
+  uint32_t _edge;
+  uint32_t _end_edge;
+  uint32_t _word_id;
+  uint32_t _spelled;         // The letters of the prefix, as bits
+  bool _repeats;             // True if it has any letter twice
 };
 
+/* Return true if there's a path of `length` more cells leading back
+ * from `cell`, without stepping on a cell in `visited`, whose cells
+ * are each in the set of cells `allowed` for their place in the path,
+ * the one next to `cell` being allowed[length - 1]. `neighbors` holds
+ * the cells next to each cell, as bits. */
+static bool path_back(int cell,
+                      const uint32_t *neighbors,
+                      const uint32_t *allowed,
+                      int length,
+                      uint32_t visited)
+{
+  if (length == 0)
+    return true;
+
+  visited |= 1U << cell;
+
+  uint32_t next = neighbors[cell] & allowed[length - 1] & ~visited;
+
+  for(; next != 0; next &= next - 1)
+    if (path_back(__builtin_ctz(next), neighbors, allowed, length - 1,
+                  visited))
+      return true;
+
+  return false;
+}
+
+/* Search `count` boards, at most GROUP_LANES of them, for the words
+ * in 'dict', adding the words found on boards[i] to found[i], which
+ * must already be sized for 'dict'. If `scores` is given, points[i]
+ * is set to the total score of the words found on boards[i], as
+ * score_words would give it.
+ *
+ * Rather than walking the dictionary once for each board, this walks
+ * it once for the whole group, keeping a bitmap of cells for each
+ * board side by side in a vector. For each prefix, a board's bitmap
+ * holds the cells that end a path spelling it, and the bitmaps for
+ * the next letter are the neighbors of those cells holding it, all
+ * found at once with a few shifts and masks. A branch of the
+ * dictionary is left as soon as every board's bitmap is empty, or
+ * every word below it needs letters none of the boards have.
+ *
+ * The bitmaps don't keep track of the cells a path has already used,
+ * so a board may seem to have a word it can only spell by reusing a
+ * cell. That can only happen if the word has a letter twice, so such
+ * words are checked against each board that seems to have them before
+ * they're added, and the words found are exactly those the other
+ * searches find. The prefixes reached are never fewer than there
+ * really are, so no word is missed.
+ *
+ * Only boards of up to GROUP_CELLS cells fit in a lane. Any others
+ * are solved on their own with search_words, or score_words.
+ */
+void boggle_board::search_group(dawg &dict,
+                                boggle_board *boards,
+                                word_set *found,
+                                int count,
+                                score_table *scores,
+                                int *points)
+{
+  assert(count <= GROUP_LANES);
+
+  int lane_board[GROUP_LANES];
+  int lanes = 0;
+  int same_width = 0;        // The width of every board, if they match
+
+  // The cells holding each letter, those with a neighbor to their
+  // right and left, and each board's width, lane by lane.
+  lane_bits letters[26] = { };
+  lane_bits has_right = { }, has_left = { }, width = { };
+
+  // The cells next to each cell of each board, for checking words
+  uint32_t neighbors[GROUP_LANES][GROUP_CELLS];
+
+  // The letters on any of the boards, and those on any one of them
+  // twice
+  uint32_t group_letters = 0, group_doubled = 0;
+
+  for(int i = 0; i < count; i++) {
+    boggle_board &board = boards[i];
+
+    if (scores)
+      points[i] = 0;
+
+    if ((board._cell_count > GROUP_CELLS) || (board._xsize >= GROUP_CELLS)) {
+      if (scores)
+        points[i] = board.score_words(dict, found[i], *scores);
+      else
+        board.search_words(dict, found[i]);
+
+      continue;
+    }
+
+    board.prepare_search();
+
+    int lane = lanes++;
+
+    lane_board[lane] = i;
+
+    for(int cell = 0; cell < board._cell_count; cell++) {
+      int x = cell % board._xsize;
+
+      if (board._letters[cell] < 26)
+        letters[board._letters[cell]][lane] |= 1U << cell;
+
+      if (x < board._xsize - 1)
+        has_right[lane] |= 1U << cell;
+
+      if (x > 0)
+        has_left[lane] |= 1U << cell;
+
+      neighbors[lane][cell] = 0;
+
+      for(int j = 0; j < board._neighbor_count[cell]; j++)
+        neighbors[lane][cell] |= 1U << board._neighbors[cell * 8 + j];
+    }
+
+    width[lane] = board._xsize;
+    same_width = ((lane == 0) || (same_width == board._xsize))
+      ? board._xsize : -1;
+    group_letters |= board._board_letters;
+    group_doubled |= board._board_doubled;
+  }
+
+  if (lanes == 0)
+    return;
+
+  group_frame stack[MAX_WORD_SIZE];
+  uint32_t root = dict.root();
+  int depth = 0;
+
+  stack[0]._next = ~(lane_bits){ };
+  stack[0]._edge = dict.first_edge(root);
+  stack[0]._end_edge = dict.end_edge(root);
+  stack[0]._word_id = 0;
+  stack[0]._spelled = 0;
+  stack[0]._repeats = false;
+
+  while (depth >= 0) {
+    group_frame &frame = stack[depth];
+
+    if (frame._edge == frame._end_edge) {
+      depth--;
+      continue;
+    }
+
+    uint32_t edge = frame._edge++;
+
+    if (!dict.edge_fits(edge, group_letters, group_doubled))
+      continue;
+
+    int letter = dict.edge_letter(edge);
+    lane_bits reach = letters[letter] & frame._next;
+
+    if (!any_lane(reach))
+      continue;
+
+    uint32_t node = dict.edge_target(edge);
+    uint32_t id = frame._word_id + dict.edge_word_offset(edge);
+    bool repeats = frame._repeats || (frame._spelled & (1U << letter));
+
+    if (dict.is_word(node))
+      for(int lane = 0; lane < lanes; lane++) {
+        int i = lane_board[lane];
+
+        if (!reach[lane] || found[i].contains(id))
+          continue;
+
+        if (repeats) {
+          // Look for a path back from a cell the word can end on,
+          // through cells its prefixes can end on.
+          uint32_t allowed[MAX_WORD_SIZE];
+          uint32_t ends;
+
+          for(int k = 0; k < depth; k++)
+            allowed[k] = stack[k + 1]._reach[lane];
+
+          for(ends = reach[lane]; ends != 0; ends &= ends - 1)
+            if (path_back(__builtin_ctz(ends), neighbors[lane], allowed,
+                          depth, 0))
+              break;
+
+          if (ends == 0)
+            continue;
+        }
+
+        found[i].add(id);
+
+        if (scores)
+          points[i] += scores->score(depth + 1);
+      }
+
+    if ((depth + 1 == MAX_WORD_SIZE - 1)
+        || (dict.first_edge(node) == dict.end_edge(node)))
+      continue;
+
+    // Every cell next to one the prefix can end on, found for all
+    // of them at once. A cell is only next to itself if it's next to
+    // another cell the prefix can end on.
+    lane_bits side = ((reach & has_right) << 1) | ((reach & has_left) >> 1);
+    lane_bits row = reach | side;
+
+    depth++;
+
+    // Shifting every lane by the same amount is a single instruction
+    // on far more targets than shifting each by its own.
+    if (same_width > 0)
+      stack[depth]._next = side | (row << same_width) | (row >> same_width);
+    else
+      stack[depth]._next = side | (row << width) | (row >> width);
+
+    stack[depth]._reach = reach;
+    stack[depth]._edge = dict.first_edge(node);
+    stack[depth]._end_edge = dict.end_edge(node);
+    stack[depth]._word_id = id;
+    stack[depth]._spelled = frame._spelled | (1U << letter);
+    stack[depth]._repeats = repeats;
+  }
+}
+
+template void boggle_board::find_words(wordtree &, wordtree &);
+template void boggle_board::find_words(dawg &, wordtree &);
+template void boggle_board::find_words(word_version &, wordtree &);
+template void boggle_board::find_words(wordtree &, wordtree &, thread_pool &);
+template void boggle_board::find_words(dawg &, wordtree &, thread_pool &);
+
 /**
  * Write a board to the given ostream.
  */
 ostream &operator <<(ostream &o, boggle_board &board) {
-     cout << "{{" << board.xsize() << ' ' << board.ysize() << "}";
+     o << "{{" << board.xsize() << ' ' << board.ysize() << "}";
      for(int i = 1; i <= board.xsize(); i++) {
-          cout << "{";
+          o << "{";
           for(int j = 1; j <= board.ysize(); j++) {
                o << board.ref(i,j);
                if (j == board.ysize())
-                    cout << "}";
+                    o << "}";
                else
-                    cout << ' ';
+                    o << ' ';
           }
      }
-     cout << '}';
+     o << '}';
 
      return o;
 }
@@ -230,6 +1158,7 @@ istream &operator >>(istream &i, boggle_board &board) {
 
   i >> xsize;
   i >> ysize;
+  if (!i || (xsize <= 0) || (ysize <= 0)) goto failed_read;
 
   skip_whitespace(i);
   if (!expect(i, '}')) goto failed_read;
@@ -249,7 +1178,10 @@ istream &operator >>(istream &i, boggle_board &board) {
     skip_whitespace(i);
     if (!expect(i, '}')) goto failed_read;
   }
-      
+
+  skip_whitespace(i);
+  if (!expect(i, '}')) goto failed_read;
+
   return i;
 
 failed_read:
@@ -257,3 +1189,50 @@ failed_read:
   return i;
 }
 
+
+/*
+ * Read a board from a scanner, in the same format as above.
+ */
+scanner &operator >>(scanner &s, boggle_board &board) {
+  int xsize, ysize;
+  int xloc, yloc;
+  int ch;
+
+  s.skip_whitespace();
+  if (!s.expect('{')) goto failed_read;
+
+  s.skip_whitespace();
+  if (!s.expect('{')) goto failed_read;
+
+  if (!s.read_int(xsize) || !s.read_int(ysize)) goto failed_read;
+  if ((xsize <= 0) || (ysize <= 0)) goto failed_read;
+
+  s.skip_whitespace();
+  if (!s.expect('}')) goto failed_read;
+
+  board.set_size(xsize, ysize);
+
+  for(xloc = 1; xloc <= xsize; xloc++) {
+    s.skip_whitespace();
+    if (!s.expect('{')) goto failed_read;
+
+    for(yloc = 1; yloc <= ysize; yloc++) {
+      s.skip_whitespace();
+      ch = s.get();
+      if ((ch == EOF) || (ch == '{') || (ch == '}')) goto failed_read;
+      board.set(xloc, yloc, ch);
+    }
+
+    s.skip_whitespace();
+    if (!s.expect('}')) goto failed_read;
+  }
+
+  s.skip_whitespace();
+  if (!s.expect('}')) goto failed_read;
+
+  return s;
+
+failed_read:
+  s.set_fail();
+  return s;
+}
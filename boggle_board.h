@@ -16,9 +16,64 @@
 #ifndef __BOGGLE_BOARD_H
 #define __BOGGLE_BOARD_H
 
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
 #include "common.h"
 #include "wordtree.h"
-#include "boggle_board.h"
+#include "dawg.h"
+#include "thread_pool.h"
+
+class scanner;
+class score_table;
+
+/* Counters kept by a board search, when it's given somewhere to keep
+ * them. They add up over every search made with them, and the
+ * searches made by different threads can be kept apart and then
+ * added together. */
+struct search_stats {
+  search_stats();
+  void clear();
+  void add(search_stats &other);
+
+  void enter(bool is_word);
+  void leave();
+  void visit(uint32_t node);
+
+  uint64_t _nodes_visited;   // Steps taken onto a cell
+  uint64_t _branches_pruned; // Steps refused because no word continues
+                             // with the cell's letter
+  uint64_t _word_hits;       // Words reached, counting every path
+  int _max_depth;            // The longest path taken, in cells
+
+  int _depth;                // The length of the current path
+
+  vector<uint64_t> _node_visits; // Searches reaching each dawg node, if
+                                 // sized for the dawg by the caller
+};
+
+inline void search_stats::enter(bool is_word)
+{
+  _nodes_visited++;
+
+  if (is_word)
+    _word_hits++;
+
+  if (++_depth > _max_depth)
+    _max_depth = _depth;
+}
+
+inline void search_stats::leave()
+{
+  _depth--;
+}
+
+inline void search_stats::visit(uint32_t node)
+{
+  if (node < _node_visits.size())
+    _node_visits[node]++;
+}
 
 class boggle_board {
 public:
@@ -30,6 +85,7 @@ public:
   ~boggle_board();
 
   void shuffle();
+  void shuffle(counter_random &random);
   char ref(int x, int y);
   void set(int x, int y, char ch);
 
@@ -40,17 +96,93 @@ public:
   int xsize();
   int ysize();
 
-  void find_words(wordtree &, wordtree &);
-  void find_words_at(int xloc, int yloc, wordtree::iterator, wordtree &);
+  void set_stats(search_stats *stats);
+
+  template<class DICT> void find_words(DICT &, wordtree &);
+  template<class DICT> void find_words(DICT &, wordtree &, thread_pool &);
+
+  void search_words(dawg &, word_set &);
+  void search_words(dawg &, word_set &, thread_pool &);
+
+  int score_words(dawg &, word_set &, score_table &);
+
+  // The most boards search_group solves at once, and the most cells
+  // a board can have to be solved alongside others.
+  static const int GROUP_LANES = 16;
+  static const int GROUP_CELLS = 32;
+
+  static void search_group(dawg &, boggle_board *boards, word_set *found,
+                           int count, score_table *scores = NULL,
+                           int *points = NULL);
+
+  typedef function<void(const vector<uint32_t> &ids)> found_fn;
+
+  void search_tiles(dawg &, word_set &, int tile_size, thread_pool &,
+                    const found_fn &fn);
 private:
+  /* The scratch space used by one thread running search_words. */
+  struct search_frame {
+    int _cell;
+    uint32_t _edge;
+    uint32_t _end_edge;
+    uint32_t _word_id;      // The id of the first word below the node
+    int _next_neighbor;
+  };
+
+  struct search_state {
+    search_state();
+    ~search_state();
+    void set_cell_count(int cell_count);
+
+    uint64_t *_visited;
+    search_frame _stack[MAX_WORD_SIZE];
+  };
+
+  template<class RANDOM> void fill_random(RANDOM random);
+
+  int cell_index(int x, int y);
+  void set_neighbors();
+  void release_neighbors();
+  void prepare_search();
+  void search_region(dawg &, word_set &, int x, int y, int xsize, int ysize);
+  template<class FOUND>
+  void search_from(int start, dawg &, search_state &, FOUND &,
+                   search_stats *);
+  bool can_follow(dawg &, uint32_t edge);
+  void count_pruned(int cell, uint32_t node, dawg &, uint64_t *visited,
+                    search_stats *);
+
+  template<class ITER>
+  void find_words_at(int xloc, int yloc, ITER, bool *marks, wordtree &,
+                     search_stats *);
+  template<class ITER>
+  void find_words_toward(int xloc, int yloc, int direction, ITER,
+                         bool *marks, wordtree &, search_stats *);
+
   int _xsize, _ysize;
 
   char *_board;
   bool *_marks;
+
+  // The board's cells numbered 0 to _cell_count - 1, without the
+  // border, as used by search_words. Only _cell_count is kept up to
+  // date by set_size; the rest are built by the first search.
+  int _cell_count;
+  int *_cell_offset;         // The index of each cell in _board
+  int *_neighbors;           // Up to eight neighbors per cell
+  int *_neighbor_count;
+  uint8_t *_letters;         // Each cell's letter, 0-25
+  uint32_t *_neighbor_letters; // The letters next to each cell, as bits
+  uint32_t _board_letters;   // The letters on the board, as bits
+  uint32_t _board_doubled;   // ... and those on it more than once
+  search_state _search;
+
+  search_stats *_stats;      // Where searches keep counters, if anywhere
 };
 
 ostream &operator <<(ostream &o, boggle_board &board);
 istream &operator >>(istream &o, boggle_board &board);
+scanner &operator >>(scanner &s, boggle_board &board);
 
 #endif
 
@@ -17,24 +17,64 @@
 #include <time.h>
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <algorithm>
+#include <chrono>
 #include <fstream>
+#include <sstream>
 
 #include "common.h"
 #include "wordtree.h"
+#include "dawg.h"
+#include "thread_pool.h"
 #include "boggle_board.h"
+#include "scanner.h"
+#include "score.h"
+#include "optimizer.h"
 
 char *solution_dict_file = NULL;     // The dictionary file to read
 char *puzzle_file        = NULL;     // The puzzle file to read
 char *ignore_file        = NULL;     // The file containing words to ignore
+char *compiled_dict_file = NULL;     // The dictionary image to write
+char *batch_file         = NULL;     // The file of boards to solve in bulk
+char *serve_socket       = NULL;     // The socket to answer requests on
+vector<char *> lexicon_files;        // Word lists to solve against at once
+char *checkpoint_file    = NULL;     // Where an exhaustive search saves progress
+char *profile_file       = NULL;     // Boards to lay a dictionary image out for
 
 bool generate_puzzle            = false;    // action flag to generate the puzzle
 bool help                = false;    // display help information
 bool write_puzzle        = false;    // write the final puzzle
+bool use_dawg            = false;    // solve using a minimized dictionary
+bool iterative_search    = false;    // solve using search_words
+bool lockstep_search     = false;    // solve batches with search_group
+bool show_stats          = false;    // report counters and timings
+bool score_only          = false;    // write scores rather than words
+bool exhaustive          = false;    // search every board for the best
 
-int size                 = 5;        // The size of the puzzle to be generated
+int board_size           = 5;        // The size of the puzzle to be generated
 
 int seed                 = -1;       // The random number seed
 
+int thread_count         = 1;        // The number of solver threads
+int tile_size            = 0;        // Solve a tile this wide at a time
+
+long generate_count      = 0;        // The number of boards to generate
+int min_words            = 0;        // Generated boards need this many words
+int min_score            = 0;        // ... and this high a score
+
+long optimize_steps      = 0;        // Annealing steps in each chain
+int chain_count          = 0;        // Annealing chains, one per thread if 0
+
+score_table scoring;                 // Points for words by length
+
 // A set of definitions of long command line options
 option long_options[] = {
   {"solution-dictionary-file", 1, 0, 'd'},
@@ -44,6 +84,25 @@ option long_options[] = {
   {"write-puzzle", 0, 0, 'w'},
   {"size", 1, 0, 'S'},
   {"random-seed", 1, 0, 'r'},
+  {"dawg", 0, 0, 'a'},
+  {"compile-dictionary", 1, 0, 'c'},
+  {"batch-file", 1, 0, 'b'},
+  {"threads", 1, 0, 't'},
+  {"engine", 1, 0, 'e'},
+  {"stats", 0, 0, 's'},
+  {"serve", 1, 0, 'l'},
+  {"generate-count", 1, 0, 'n'},
+  {"min-words", 1, 0, 'k'},
+  {"min-score", 1, 0, 'm'},
+  {"optimize", 1, 0, 'o'},
+  {"chains", 1, 0, 'C'},
+  {"score-only", 0, 0, 'x'},
+  {"scoring", 1, 0, 'P'},
+  {"tile-size", 1, 0, 'T'},
+  {"lexicon", 1, 0, 'L'},
+  {"exhaustive", 0, 0, 'E'},
+  {"checkpoint", 1, 0, 'K'},
+  {"profile-boards", 1, 0, 'B'},
   {"help", 0, 0, 'h'},
   {0, 0, 0, 0}
 };
@@ -69,7 +128,91 @@ ignore\n\
 --write-puzzle (-w) - Write the puzzle to standard output\n\
 \n\
 --size=<size> (-S) - Set the size of the boggle puzzle board\n\
---random-seed=<number> (-r) - Set the seed value for rand()";
+--random-seed=<number> (-r) - Set the seed value for rand()\n\
+\n\
+--dawg (-a) - Minimize the dictionary into a DAWG before solving\n\
+--compile-dictionary=<filename> (-c) - Write the solution dictionary,\n\
+    less any ignored words, to <filename> as a precompiled image.\n\
+    Passing such an image to -d maps it directly into memory.\n\
+--profile-boards=<filename> (-B) - With --compile-dictionary, solve\n\
+    the boards in <filename> first, and lay the image out so that the\n\
+    parts of the dictionary they search most are close together.\n\
+--batch-file=<filename> (-b) - Solve every board in <filename> against\n\
+    the solution dictionary, writing one result per board. The\n\
+    dictionary is loaded only once.\n\
+--threads=<number> (-t) - Set the number of threads used to solve. A\n\
+    single board is split across the threads; a batch is solved one\n\
+    board per thread, with results written in input order.\n\
+--engine=<name> (-e) - Select the search used to solve boards:\n\
+    recursive - The original recursive search (the default)\n\
+    iterative - A faster search over a DAWG; implies --dawg\n\
+    lockstep  - The iterative search, but a batch is solved sixteen\n\
+                boards at a time, with one walk of the DAWG for all\n\
+                of them. Boards of more than 32 cells, and single\n\
+                boards, are solved as with iterative.\n\
+--stats (-s) - Write search counters and the time spent in each phase\n\
+    to standard error, as JSON. With more than one thread, the solve\n\
+    and print times are summed over the threads.\n\
+--serve=<path> (-l) - Load the dictionary once, then answer solve and\n\
+    generate requests from clients of a Unix socket at <path>, across\n\
+    the solver threads, until interrupted. Each request and response\n\
+    is preceded by its length, as four bytes in network byte order:\n\
+        solve <board>     - answered with ok <words>\n\
+        score <board>     - answered with ok <score> <word count>,\n\
+                            with --engine=iterative\n\
+        generate [<size>] - answered with ok <board>\n\
+        add <words>       - add words to the dictionary, and\n\
+        remove <words>    - remove them, both answered with\n\
+                            ok <dictionary version>\n\
+        reload            - read the dictionary and ignore files\n\
+                            again, answered as for add\n\
+    Failed requests are answered with error <message>. Solves already\n\
+    under way when the words change finish with the words they started\n\
+    with. The words can only change with a text dictionary and the\n\
+    recursive engine.\n\
+--generate-count=<number> (-n) - Generate <number> boards of the given\n\
+    size, one per line, across the solver threads. Board i is drawn\n\
+    from its own random stream, so the same seed always gives the\n\
+    same boards, whatever the number of threads.\n\
+--min-words=<number> (-k) - Only generate boards with at least\n\
+    <number> words from the solution dictionary\n\
+--min-score=<number> (-m) - Only generate boards scoring at least\n\
+    <number> points with the solution dictionary. With --exhaustive,\n\
+    only search for boards scoring at least this much.\n\
+--optimize=<steps> (-o) - Search for the highest scoring board of the\n\
+    given size by simulated annealing, running each chain for <steps>\n\
+    steps, and write the best board found and its score.\n\
+--chains=<number> (-C) - Set the number of annealing chains, which are\n\
+    run across the solver threads. Defaults to one per thread.\n\
+--exhaustive (-E) - Search every board of the given size, of up to 32\n\
+    cells, for the highest scoring one, and write it and its score.\n\
+    Classes of boards, with a set of letters for each cell, are\n\
+    searched together by bounding their scores, so only the classes\n\
+    that might hold a better board than any found yet are split. The\n\
+    board written is the best there is. This can take many hours, less\n\
+    with a good --min-score.\n\
+--checkpoint=<filename> (-K) - With --exhaustive, record progress in\n\
+    <filename> as the search goes, and carry on from where it left\n\
+    off if it was stopped.\n\
+--score-only (-x) - Write each board's score and number of words,\n\
+    rather than its words. Implies --engine=iterative.\n\
+--scoring=<points> (-P) - Set the points for words of each length,\n\
+    as a list separated by commas, starting from words of no letters.\n\
+    Longer words score as the last entry. The default is tkboggle's\n\
+    0,0,0,0,1,2,3,5,11,22,33,44,55,66\n\
+--tile-size=<cells> (-T) - Solve a single large board in square tiles\n\
+    this many cells on a side, across the solver threads, writing each\n\
+    word as soon as it is first found rather than in alphabetical\n\
+    order. Only a few tiles are searched at once, so boards of a\n\
+    million cells or more can be solved in little more memory than\n\
+    the board itself. Implies --engine=iterative.\n\
+--lexicon=<filename>[:<ignore file>] (-L) - Solve against the words in\n\
+    <filename>, a word list or compiled image, as one of up to 32\n\
+    lexicons given in place of -d. Every lexicon is searched at once,\n\
+    and each board's result is written once per lexicon, one to a\n\
+    line, in the order they were given. The words in <ignore file> are\n\
+    left out of that lexicon's results, and those in the -i file out of\n\
+    every lexicon's. Implies --engine=iterative.";
 
 /* Scan and parse the command line options, adjusting the global
  * control variables appropriately
@@ -81,7 +224,7 @@ void parse_options(int argc, char *argv[])
 
   while(optind < argc) {
     int option_index = 0;
-    char option = getopt_long(argc, argv, "d:p:i:gS:hr:w",
+    char option = getopt_long(argc, argv, "d:p:i:gS:hr:wac:b:t:e:sl:n:k:m:o:C:xP:T:L:EK:B:",
 			      long_options, &option_index);
 
     switch(option) {
@@ -117,9 +260,9 @@ void parse_options(int argc, char *argv[])
       break;
 
     case 'S':
-      size = atoi(optarg);
+      board_size = atoi(optarg);
 
-      if (size <= 0)
+      if (board_size <= 0)
 	error("Invalid argument passed for size");
       break;
 
@@ -138,7 +281,132 @@ void parse_options(int argc, char *argv[])
       write_puzzle = true;
       break;
 
+    case 'a':
+      use_dawg = true;
+      break;
+
+    case 'c':
+      if (compiled_dict_file)
+	error("Two compiled dictionary files cannot be specified");
+
+      compiled_dict_file = strdup(optarg);
+      break;
+
+    case 'b':
+      if (batch_file)
+	error("Two batch files cannot be specified");
+
+      batch_file = strdup(optarg);
+      break;
+
+    case 'e':
+      if (strcmp(optarg, "recursive") == 0) {
+	iterative_search = false;
+	lockstep_search = false;
+      } else if (strcmp(optarg, "iterative") == 0) {
+	iterative_search = true;
+	lockstep_search = false;
+      } else if (strcmp(optarg, "lockstep") == 0) {
+	iterative_search = true;
+	lockstep_search = true;
+      } else
+	error("Unknown search engine");
+      break;
+
+    case 't':
+      thread_count = atoi(optarg);
+
+      if (thread_count <= 0)
+	error("Invalid argument passed for thread count");
+      break;
+
+    case 's':
+      show_stats = true;
+      break;
+
+    case 'n':
+      generate_count = atol(optarg);
+
+      if (generate_count <= 0)
+	error("Invalid argument passed for generate count");
+      break;
+
+    case 'k':
+      min_words = atoi(optarg);
+
+      if (min_words <= 0)
+	error("Invalid argument passed for minimum words");
+      break;
+
+    case 'm':
+      min_score = atoi(optarg);
+
+      if (min_score <= 0)
+	error("Invalid argument passed for minimum score");
+      break;
+
+    case 'o':
+      optimize_steps = atol(optarg);
+
+      if (optimize_steps <= 0)
+	error("Invalid argument passed for optimize steps");
+      break;
+
+    case 'C':
+      chain_count = atoi(optarg);
+
+      if (chain_count <= 0)
+	error("Invalid argument passed for chain count");
+      break;
+
+    case 'x':
+      score_only = true;
+      break;
+
+    case 'P':
+      if (!scoring.parse(optarg))
+	error("Invalid argument passed for scoring");
+      break;
+
+    case 'E':
+      exhaustive = true;
+      break;
+
+    case 'K':
+      if (checkpoint_file)
+	error("Two checkpoint files cannot be specified");
+
+      checkpoint_file = strdup(optarg);
+      break;
+
+    case 'B':
+      if (profile_file)
+	error("Two profile board files cannot be specified");
+
+      profile_file = strdup(optarg);
+      break;
+
+    case 'L':
+      if (lexicon_files.size() == lexicon_masks::MAX_LEXICONS)
+	error("Too many lexicons specified");
+
+      lexicon_files.push_back(strdup(optarg));
       break;
+
+    case 'T':
+      tile_size = atoi(optarg);
+
+      if (tile_size <= 0)
+	error("Invalid argument passed for tile size");
+      break;
+
+    case 'l':
+      if (serve_socket)
+	error("Two sockets to serve cannot be specified");
+
+      serve_socket = strdup(optarg);
+      break;
+
     case 'h':
       help = true;
 
@@ -147,87 +415,1666 @@ void parse_options(int argc, char *argv[])
   }
 }
 
+/* Every input read from standard input shares one scanner, so that
+ * whatever it has read ahead for one input is still there for the
+ * next. */
+scanner stdin_scanner;
+
+/* Open a scanner on `fn`, which is either a file or, if it's "-",
+ * standard input. */
+scanner *open_input(const char *fn, scanner &file_in)
+{
+     if (strcmp(fn, "-") == 0) {
+          if (!stdin_scanner.is_open())
+               stdin_scanner.open("-");
+
+          return &stdin_scanner;
+     }
+
+     if (!file_in.open(fn))
+          return NULL;
+
+     return &file_in;
+}
+
 /* Read an input object from either a file or standard input. */
 template<class T>
 void read_input(const char *fn,  T &object, const char *filedesc)
 {
-     bool ok;
+     scanner file_in;
+     scanner *in = open_input(fn, file_in);
+     bool ok = (in != NULL) && (bool)(*in >> object);
 
-     if (strcmp(fn, "-") == 0) {
-          ok = (cin >> object);
-     } else {
-          ifstream in(fn);
+     if (!ok)
+          error("Error reading file.");
+}
+
+
+/* The dictionary counters and load timings reported by --stats. The
+ * counters kept while solving live with each thread's results. */
+struct load_stats {
+     double load_ms;           // Reading and building the dictionary
+     double ignore_ms;         // Reading and removing ignored words
+     int trie_nodes;           // Trie nodes allocated while loading
+     int dawg_nodes;
+};
 
-          ok = (in >> object);
+load_stats dictionary_stats;
+
+double elapsed_ms(chrono::steady_clock::time_point start)
+{
+     return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+/* Load the words listed in the ignore file, if there is one. */
+void load_ignored_words(wordtree &ignored_words)
+{
+     if (ignore_file) {
+          read_input(ignore_file, ignored_words, "ignore file");
+
+          dictionary_stats.trie_nodes += ignored_words.node_count();
      }
+}
 
-     if (!ok)
-          error("Error reading file.");
+/* Load the solution dictionary, removing any words listed in the
+ * ignore file. */
+void load_dictionary(wordtree &dictionary)
+{
+     chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+     read_input(solution_dict_file, dictionary, "dictionary file");
+
+     dictionary_stats.load_ms += elapsed_ms(start);
+     dictionary_stats.trie_nodes += dictionary.node_count();
+
+     if (ignore_file) {
+          wordtree ignored_words;
+
+          start = chrono::steady_clock::now();
+
+          load_ignored_words(ignored_words);
+
+          dictionary.delete_words(ignored_words);
+
+          dictionary_stats.ignore_ms += elapsed_ms(start);
+     }
 }
 
+/* Solve the boards in --profile-boards against `dictionary`, counting
+ * the searches that reach each of its nodes, and lay it out again for
+ * those counts. */
+void profile_dictionary(dawg &dictionary)
+{
+     scanner file_in;
+     scanner *in = open_input(profile_file, file_in);
+     boggle_board board;
+     word_set found;
+     search_stats stats;
+     long boards = 0;
+
+     if (in == NULL)
+          error("Error reading profile board file.");
 
-/* Execute the operations requested by the user */
-void do_command()
+     found.set_word_count(dictionary.word_count());
+     stats._node_visits.assign(dictionary.node_count(), 0);
+     board.set_stats(&stats);
+
+     for(;;) {
+          in->skip_whitespace();
+
+          if (in->peek() == EOF)
+               break;
+
+          if (!(*in >> board))
+               error("Error reading profile board file.");
+
+          found.clear();
+          board.search_words(dictionary, found);
+          boards++;
+     }
+
+     if (boards == 0)
+          error("No boards in the profile board file.");
+
+     dictionary.reorder(stats._node_visits);
+}
+
+/* Minimize the solution dictionary and write it out as an image. With
+ * --profile-boards, it's laid out for the boards given there. */
+void compile_dictionary()
 {
-     if (help) {
-          cout << help_text << endl;
+     dawg dictionary;
+
+     if (!solution_dict_file)
+          error("No dictionary file specified to compile");
+
+     {
+          wordtree word_list;
+
+          load_dictionary(word_list);
+          dictionary.build(word_list);
+     }
+
+     if (profile_file)
+          profile_dictionary(dictionary);
+
+     if (!dictionary.write_image(compiled_dict_file))
+          error("Error writing compiled dictionary file.");
+}
+
+/* The result sets used while solving a board. They're reused from
+ * one board to the next, and each thread solving boards needs its
+ * own. */
+struct solve_results {
+     wordtree words;           // Words found by the recursive search
+     word_set ids;             // Words found by the iterative search
+     word_set group_ids[boggle_board::GROUP_LANES]; // ... and by the
+     int group_points[boggle_board::GROUP_LANES];   // lockstep search
+     int reader;               // The reader it is, of a dictionary's versions
+
+     // Kept for --stats, over every board solved with these results
+     search_stats search;
+     long boards;
+     long unique_words;
+     double solve_ms;
+     double print_ms;
+
+     solve_results();
+     void add(solve_results &other);
+};
+
+solve_results::solve_results()
+{
+     reader = 0;
+     boards = 0;
+     unique_words = 0;
+     solve_ms = 0.0;
+     print_ms = 0.0;
+}
+
+void solve_results::add(solve_results &other)
+{
+     search.add(other.search);
+     boards += other.boards;
+     unique_words += other.unique_words;
+     solve_ms += other.solve_ms;
+     print_ms += other.print_ms;
+}
+
+/* The dictionary used to solve boards, in whichever form it was
+ * loaded. It is loaded once and then reused for every board solved.
+ */
+struct solution_dictionary {
+     wordtree words;           // The word list, when solving with the trie
+     dawg graph;               // The minimized or mapped dictionary
+     wordtree ignored_words;   // Words to filter from the results
+     vector<uint32_t> ignored_ids;
+     lexicon_masks lexicons;   // The lexicons of each word, with -L
+     int lexicon_count;
+     word_versions *versions;  // What's searched instead of `words`, if
+                               // words can change while serving
+     bool use_graph;
+     bool filter_results;
+
+     void load();
+     void load_lexicons();
+     void prepare(solve_results &results);
+     int score(boggle_board &board, solve_results &results);
+     void write_lexicons(word_set &ids, ostream &out);
+     void solve(boggle_board &board,
+                solve_results &results,
+                ostream &out,
+                thread_pool *pool = NULL);
+     void solve_group(boggle_board *boards,
+                      int count,
+                      solve_results &results,
+                      ostream &out);
+     void solve_tiles(boggle_board &board,
+                      solve_results &results,
+                      ostream &out,
+                      thread_pool &pool);
+};
+
+void solution_dictionary::load()
+{
+     use_graph = false;
+     filter_results = false;
+     lexicon_count = 0;
+     versions = NULL;
+
+     if (!lexicon_files.empty()) {
+          load_lexicons();
           return;
      }
 
-     boggle_board board;
+     chrono::steady_clock::time_point start = chrono::steady_clock::now();
 
-     // Initalize the random number generator
-     srand((seed == -1) ? time(0) : seed);
+     if (dawg::is_image(solution_dict_file)) {
+          if (!graph.map_image(solution_dict_file))
+               error("Invalid compiled dictionary file.");
 
-     // Generate or load a puzzle board.
-     if (generate_puzzle) {
-          board.set_size(size);
-          board.shuffle();
+          dictionary_stats.load_ms += elapsed_ms(start);
+          start = chrono::steady_clock::now();
 
-     } else if (puzzle_file) {
-          read_input(puzzle_file, board, "puzzle file");
+          // An image can't be edited, so ignored words are removed
+          // from the results instead.
+          load_ignored_words(ignored_words);
+          graph.word_ids(ignored_words, ignored_ids);
+
+          dictionary_stats.ignore_ms += elapsed_ms(start);
+
+          use_graph = true;
+          filter_results = (ignore_file != NULL);
+
+     } else if (use_dawg || iterative_search) {
+          // The wordtree is only needed long enough to be minimized,
+          // so release it before solving.
+          wordtree word_list;
+
+          load_dictionary(word_list);
+
+          start = chrono::steady_clock::now();
+          graph.build(word_list);
+          dictionary_stats.load_ms += elapsed_ms(start);
+
+          use_graph = true;
 
      } else
-          warn("No valid puzzle specified");
+          load_dictionary(words);
 
-     // write the puzzle board in use.
-     if (write_puzzle)
-          cout << board << endl;
+     if (use_graph)
+          dictionary_stats.dawg_nodes = graph.node_count();
+}
 
-     // Solve the puzzle board, if requested.
+/* Read the word list, or compiled image, `filename` into `words`. */
+void load_word_list(const char *filename, wordtree &words)
+{
+     if (dawg::is_image(filename)) {
+          dawg image;
+          char buf[MAX_WORD_SIZE];
+
+          if (!image.map_image(filename))
+               error("Invalid compiled dictionary file.");
+
+          for(int id = 0; id < image.word_count(); id++)
+               if (image.word(id, buf))
+                    words.insert_word(buf);
+     } else
+          read_input(filename, words, "lexicon file");
+}
+
+/* Build the dictionary from the words of every lexicon given with -L,
+ * noting which lexicons each word is in. Words are ignored by leaving
+ * them out of a lexicon, so all the lexicons share one dawg, and one
+ * search of a board finds the words of them all.
+ */
+void solution_dictionary::load_lexicons()
+{
+     chrono::steady_clock::time_point start = chrono::steady_clock::now();
+     vector<wordtree> lists(lexicon_files.size());
+     vector<string> ignore_files(lexicon_files.size());
+     wordtree all_words;
+     vector<uint32_t> ids;
+
+     for(size_t i = 0; i < lexicon_files.size(); i++) {
+          string filename(lexicon_files[i]);
+          size_t colon = filename.find(':');
 
-     if (solution_dict_file) {
-          wordtree dictionary;
-          wordtree results;
+          if (colon != string::npos) {
+               ignore_files[i] = filename.substr(colon + 1);
+               filename.erase(colon);
+          }
+
+          load_word_list(filename.c_str(), lists[i]);
+          all_words.insert_words(lists[i]);
+     }
+
+     graph.build(all_words);
+     lexicons.set_word_count(graph.word_count());
+
+     dictionary_stats.load_ms += elapsed_ms(start);
+     dictionary_stats.trie_nodes += all_words.node_count();
+     dictionary_stats.dawg_nodes = graph.node_count();
+     start = chrono::steady_clock::now();
+
+     for(size_t i = 0; i < lists.size(); i++) {
+          ids.clear();
+          graph.word_ids(lists[i], ids);
+          lexicons.add(i, ids);
+
+          if (!ignore_files[i].empty()) {
+               wordtree ignored_words;
+
+               read_input(ignore_files[i].c_str(), ignored_words, "ignore file");
 
-          read_input(solution_dict_file, dictionary, "dictionary file");
+               ids.clear();
+               graph.word_ids(ignored_words, ids);
+               lexicons.remove(i, ids);
+          }
+     }
 
+     if (ignore_file) {
           wordtree ignored_words;
 
-          if (ignore_file) {
-               read_input(ignore_file, ignored_words, "puzzle file");
+          load_ignored_words(ignored_words);
+
+          ids.clear();
+          graph.word_ids(ignored_words, ids);
+
+          for(size_t i = 0; i < lists.size(); i++)
+               lexicons.remove(i, ids);
+     }
+
+     dictionary_stats.ignore_ms += elapsed_ms(start);
+
+     lexicon_count = lists.size();
+     use_graph = true;
+}
+
+/* Ready a set of results to be used with this dictionary. */
+void solution_dictionary::prepare(solve_results &results)
+{
+     if (!use_graph)
+          return;
+
+     results.ids.set_word_count(graph.word_count());
+
+     for(size_t i = 0; i < ignored_ids.size(); i++)
+          results.ids.ignore(ignored_ids[i]);
+
+     if (!lockstep_search)
+          return;
+
+     for(int i = 0; i < boggle_board::GROUP_LANES; i++) {
+          results.group_ids[i].set_word_count(graph.word_count());
+
+          for(size_t j = 0; j < ignored_ids.size(); j++)
+               results.group_ids[i].ignore(ignored_ids[j]);
+     }
+}
+
+/* Return the score of `board`, leaving the words found in
+ * `results`, which must have been readied by prepare(). Only the
+ * iterative search over a dawg can score boards without listing their
+ * words, so the dictionary must be loaded for it. */
+int solution_dictionary::score(boggle_board &board, solve_results &results)
+{
+     results.ids.clear();
+
+     return board.score_words(graph, results.ids, scoring);
+}
+
+/* Find the words on `board`, and write them to `out`. `results` must
+ * have been readied by prepare(). If `pool` is given, the search is
+ * spread across its threads. The dictionary itself is never
+ * modified, so several threads may solve against it at once. With
+ * --stats, the board's search counters and the time taken are added
+ * to `results`.
+ */
+void solution_dictionary::solve(boggle_board &board,
+                                solve_results &results,
+                                ostream &out,
+                                thread_pool *pool)
+{
+     bool by_id = use_graph && iterative_search;
+     chrono::steady_clock::time_point start;
+     int points = 0;
+
+     if (show_stats) {
+          board.set_stats(&results.search);
+          start = chrono::steady_clock::now();
+     }
+
+     if (score_only) {
+          points = score(board, results);
+     } else if (by_id) {
+          results.ids.clear();
+
+          if (pool)
+               board.search_words(graph, results.ids, *pool);
+          else
+               board.search_words(graph, results.ids);
+     } else {
+          results.words.clear();
+
+          if (use_graph) {
+               if (pool)
+                    board.find_words(graph, results.words, *pool);
+               else
+                    board.find_words(graph, results.words);
+          } else if (versions) {
+               // The words may change, but not the version searched.
+               word_version *version = versions->enter(results.reader);
 
-               dictionary.delete_words(ignored_words);
+               board.find_words(*version, results.words);
+               versions->leave(results.reader);
+          } else {
+               if (pool)
+                    board.find_words(words, results.words, *pool);
+               else
+                    board.find_words(words, results.words);
           }
 
-          board.find_words(dictionary, results);
+          if (filter_results)
+               results.words.delete_words(ignored_words);
+     }
 
-          cout << results << endl;
+     if (show_stats) {
+          results.solve_ms += elapsed_ms(start);
+          results.boards++;
+          results.unique_words += by_id ? results.ids.size()
+                                        : results.words.word_count();
+          start = chrono::steady_clock::now();
      }
+
+     if (lexicon_count > 0)
+          write_lexicons(results.ids, out);
+     else if (score_only)
+          out << points << ' ' << results.ids.size();
+     else if (by_id)
+          graph.write_words(out, results.ids);
+     else
+          out << results.words;
+
+     if (show_stats)
+          results.print_ms += elapsed_ms(start);
 }
 
-int main(int argc, char *argv[])
+/* Solve `count` boards of a batch, writing a record for each one to
+ * `out` in turn, as solve_batch does. With the lockstep engine, they
+ * are searched together, so there can be no more than
+ * boggle_board::GROUP_LANES of them; otherwise they're solved one at
+ * a time. `results` must have been readied by prepare().
+ */
+void solution_dictionary::solve_group(boggle_board *boards,
+                                      int count,
+                                      solve_results &results,
+                                      ostream &out)
 {
-  // Parse the command line options
-  parse_options(argc, argv);
+     if (!lockstep_search) {
+          for(int i = 0; i < count; i++) {
+               if (write_puzzle)
+                    out << boards[i] << '\n';
 
-  // Execute the requested command
-  do_command();
+               solve(boards[i], results, out);
+               out << '\n';
+          }
 
-  // Delete the dynamic storage used by the command line options
-  delete solution_dict_file;
-  delete puzzle_file;
-  delete ignore_file;
+          return;
+     }
+
+     chrono::steady_clock::time_point start;
+
+     if (show_stats)
+          start = chrono::steady_clock::now();
+
+     for(int i = 0; i < count; i++)
+          results.group_ids[i].clear();
+
+     boggle_board::search_group(graph, boards, results.group_ids, count,
+                                score_only ? &scoring : NULL,
+                                results.group_points);
+
+     if (show_stats) {
+          results.solve_ms += elapsed_ms(start);
+          results.boards += count;
+
+          for(int i = 0; i < count; i++)
+               results.unique_words += results.group_ids[i].size();
+
+          start = chrono::steady_clock::now();
+     }
+
+     for(int i = 0; i < count; i++) {
+          if (write_puzzle)
+               out << boards[i] << '\n';
+
+          if (lexicon_count > 0)
+               write_lexicons(results.group_ids[i], out);
+          else if (score_only)
+               out << results.group_points[i] << ' '
+                   << results.group_ids[i].size();
+          else
+               graph.write_words(out, results.group_ids[i]);
+
+          out << '\n';
+     }
+
+     if (show_stats)
+          results.print_ms += elapsed_ms(start);
+}
+
+/* Write the words in `ids` once for each lexicon, on lines of
+ * their own, keeping only the words in that lexicon. With
+ * --score-only, each lexicon's score and number of words is written
+ * instead, with every word's length found only once.
+ */
+void solution_dictionary::write_lexicons(word_set &ids, ostream &out)
+{
+     if (!score_only) {
+          for(int i = 0; i < lexicon_count; i++) {
+               if (i > 0)
+                    out << '\n';
+
+               graph.write_words(out, ids, i, lexicons);
+          }
+
+          return;
+     }
+
+     vector<int> points(lexicon_count, 0);
+     vector<int> counts(lexicon_count, 0);
+     vector<uint32_t> &found = ids.ids();
+     char buf[MAX_WORD_SIZE];
+
+     for(size_t i = 0; i < found.size(); i++) {
+          uint32_t mask = lexicons.mask(found[i]);
+
+          if ((mask == 0) || !graph.word(found[i], buf))
+               continue;
+
+          int word_points = scoring.score(strlen(buf));
+
+          for(int j = 0; j < lexicon_count; j++)
+               if (mask & (1U << j)) {
+                    points[j] += word_points;
+                    counts[j]++;
+               }
+     }
+
+     for(int i = 0; i < lexicon_count; i++) {
+          if (i > 0)
+               out << '\n';
+
+          out << points[i] << ' ' << counts[i];
+     }
+}
+
+/* Solve `board` a tile at a time, across the threads of `pool`, for
+ * boards too big to solve in one piece. Each word is written to `out`
+ * as soon as it is first found, so the words are in no particular
+ * order, and the only results kept are the ids already written. With
+ * --score-only, the words are scored rather than written. The
+ * dictionary must be loaded for the iterative search.
+ */
+void solution_dictionary::solve_tiles(boggle_board &board,
+                                      solve_results &results,
+                                      ostream &out,
+                                      thread_pool &pool)
+{
+     chrono::steady_clock::time_point start = chrono::steady_clock::now();
+     char buf[MAX_WORD_SIZE];
+     int points = 0;
+
+     if (show_stats)
+          board.set_stats(&results.search);
+
+     results.ids.clear();
+
+     if (!score_only)
+          out << "{";
+
+     board.search_tiles(graph, results.ids, tile_size, pool,
+                        [&](const vector<uint32_t> &ids) {
+               for(size_t i = 0; i < ids.size(); i++) {
+                    if (!graph.word(ids[i], buf))
+                         continue;
+
+                    if (score_only)
+                         points += scoring.score(strlen(buf));
+                    else
+                         out << buf << ' ';
+               }
+          });
+
+     if (score_only)
+          out << points << ' ' << results.ids.size();
+     else
+          out << "}";
+
+     // The words are written as they're found, so the time taken to
+     // write them is part of the solve.
+     if (show_stats) {
+          results.solve_ms += elapsed_ms(start);
+          results.boards++;
+          results.unique_words += results.ids.size();
+     }
+}
+
+/* Write the counters and timings gathered in `results` and
+ * dictionary_stats to standard error, as JSON. */
+void write_stats(solve_results &results)
+{
+     search_stats &search = results.search;
+
+     cerr << "{\"boards\": " << results.boards
+          << ", \"dictionary\": {\"trie_nodes\": " << dictionary_stats.trie_nodes
+          << ", \"dawg_nodes\": " << dictionary_stats.dawg_nodes << "}"
+          << ", \"search\": {\"nodes_visited\": " << search._nodes_visited
+          << ", \"branches_pruned\": " << search._branches_pruned
+          << ", \"max_depth\": " << search._max_depth
+          << ", \"word_hits\": " << search._word_hits
+          << ", \"unique_words\": " << results.unique_words << "}"
+          << ", \"time_ms\": {\"load\": " << dictionary_stats.load_ms
+          << ", \"ignore_filter\": " << dictionary_stats.ignore_ms
+          << ", \"solve\": " << results.solve_ms
+          << ", \"print\": " << results.print_ms << "}}" << endl;
+}
+
+/* The number of boards of a batch solved together, by the lockstep
+ * engine, or one at a time. */
+int batch_group_size()
+{
+     return lockstep_search ? boggle_board::GROUP_LANES : 1;
+}
+
+/* Solve each board in a stream of boards, writing one result record
+ * per board. Each record has the same form as the output of a single
+ * board run. */
+void solve_batch(scanner &in, solution_dictionary &dictionary)
+{
+     int group_size = batch_group_size();
+     boggle_board *boards = new boggle_board[group_size];
+     solve_results results;
+
+     dictionary.prepare(results);
+
+     for(;;) {
+          int count;
+
+          for(count = 0; count < group_size; count++) {
+               in.skip_whitespace();
+
+               if (in.peek() == EOF)
+                    break;
+
+               if (!(in >> boards[count])) {
+                    dictionary.solve_group(boards, count, results, cout);
+                    error("Error reading batch file.");
+               }
+          }
+
+          if (count == 0)
+               break;
+
+          dictionary.solve_group(boards, count, results, cout);
+     }
+
+     cout.flush();
+
+     if (show_stats)
+          write_stats(results);
+
+     delete [] boards;
+}
+
+/* Read the text of the next board from a batch stream, by matching
+ * up its braces. Returns false at the end of the stream. */
+bool read_board_text(scanner &in, string &text)
+{
+     in.skip_whitespace();
+
+     if (in.peek() == EOF)
+          return false;
+
+     if (!in.read_group(text))
+          error("Error reading batch file.");
+
+     return true;
+}
+
+/* One board of a parallel batch, and the result record it produces. */
+struct batch_slot {
+     string input;
+     string output;
+     bool failed;
+     atomic<bool> ready;
+};
+
+/* Solve a stream of boards across every thread in `pool`, writing the
+ * results in input order. The calling thread reads boards and hands
+ * each one to the pool as a job; the pool's workers steal jobs from
+ * each other to stay busy. Finished records wait in a reorder window
+ * until every earlier record has been written. When the window is
+ * full, the calling thread helps solve until its oldest record is
+ * ready. Each worker parses and solves into its own boards and result
+ * set, and all of them share the one dictionary.
+ *
+ * With the lockstep engine, each job is a group of boards in
+ * consecutive slots, solved together. The records for the whole group
+ * are left in its first slot, and the rest are left empty.
+ */
+void solve_batch(scanner &in, solution_dictionary &dictionary, thread_pool &pool)
+{
+     int workers = pool.thread_count();
+     int group_size = batch_group_size();
+     boggle_board *boards = new boggle_board[workers * group_size];
+     solve_results *results = new solve_results[workers];
+
+     for(int i = 0; i < workers; i++)
+          dictionary.prepare(results[i]);
+
+     unsigned window = 16 * workers * group_size;
+     batch_slot *slots = new batch_slot[window];
+     unsigned next_in = 0, next_out = 0;
+     bool more_input = true;
+
+     while (more_input || (next_out < next_in)) {
+          batch_slot &oldest = slots[next_out % window];
+
+          if ((next_out < next_in) && oldest.ready) {
+               if (oldest.failed)
+                    error("Error reading batch file.");
+
+               cout << oldest.output;
+               next_out++;
+               continue;
+          }
+
+          if (!more_input || (next_in - next_out + group_size > window)) {
+               if (!pool.run_one())
+                    this_thread::yield();
+               continue;
+          }
+
+          // Groups are only short at the end of the input, so each one
+          // fills consecutive slots of the window.
+          batch_slot *group = &slots[next_in % window];
+          int count;
+
+          for(count = 0; count < group_size; count++) {
+               if (!read_board_text(in, group[count].input)) {
+                    more_input = false;
+                    break;
+               }
+
+               group[count].ready = false;
+          }
+
+          if (count == 0)
+               continue;
+
+          next_in += count;
+
+          pool.submit([group, count, group_size, boards, results,
+                       &dictionary](int worker) {
+                    boggle_board *worker_boards = boards + worker * group_size;
+                    ostringstream out;
+                    int parsed;
+
+                    for(parsed = 0; parsed < count; parsed++) {
+                         scanner board_in;
+
+                         board_in.open(group[parsed].input.data(),
+                                       group[parsed].input.size());
+
+                         if (!(board_in >> worker_boards[parsed]))
+                              break;
+                    }
+
+                    dictionary.solve_group(worker_boards, parsed,
+                                           results[worker], out);
+
+                    for(int i = 0; i < count; i++) {
+                         group[i].failed = (i == parsed);
+                         group[i].output.clear();
+                    }
+
+                    group[0].output = out.str();
+
+                    for(int i = 0; i < count; i++)
+                         group[i].ready = true;
+               });
+     }
+
+     cout.flush();
+
+     if (show_stats) {
+          for(int i = 1; i < workers; i++)
+               results[0].add(results[i]);
+
+          write_stats(results[0]);
+     }
+
+     delete [] slots;
+     delete [] results;
+     delete [] boards;
+}
+
+/* Requests and responses sent through the solver socket are each
+ * preceded by their length. Anything longer than this is taken to be
+ * a broken client. */
+const uint32_t MAX_FRAME_SIZE = 1 << 20;
+
+/* The largest board a client may ask to be generated. */
+const int MAX_GENERATE_SIZE = 1000;
+
+/* One client of the solver socket. The serving thread reads its
+ * requests and queues them; a pool job answers them, one at a time
+ * and in order, so a client's responses come back in the order it
+ * asked. Whichever of the two finishes with the connection last
+ * closes and frees it.
+ */
+struct serve_connection {
+     int fd;
+     string input;              // Bytes read but not yet framed
+
+     mutex lock;                // Guards the members below
+     deque<string> requests;    // Requests waiting to be answered
+     bool busy;                 // A job is answering requests
+     bool closed;               // The client has stopped sending
+};
+
+/* Requests for random boards share rand(), so they take turns. */
+mutex generate_lock;
+
+/* Reloading the dictionary reads it again, which is done once at a
+ * time. */
+mutex reload_lock;
+
+/* Read the dictionary and ignore files again, for a reload request,
+ * leaving the words in `words`. Unlike load_dictionary(), a file that
+ * can't be read makes this return FALSE rather than exit, and nothing
+ * is added to the load counters, since requests are answered on
+ * several threads at once. */
+bool reread_dictionary(wordtree &words)
+{
+     scanner dictionary_in, ignore_in;
+     wordtree ignored_words;
+
+     if (!dictionary_in.open(solution_dict_file) || !(dictionary_in >> words))
+          return false;
+
+     if (ignore_file) {
+          if (!ignore_in.open(ignore_file) || !(ignore_in >> ignored_words))
+               return false;
+
+          words.delete_words(ignored_words);
+     }
+
+     return true;
+}
+
+volatile sig_atomic_t serve_stopping = 0;
+
+void stop_serving(int)
+{
+     serve_stopping = 1;
+}
+
+/* Write `text` to `fd`, preceded by its length. */
+bool write_frame(int fd, const string &text)
+{
+     uint32_t length = htonl(text.size());
+     string frame((char *)&length, sizeof(length));
+
+     frame += text;
+
+     for(size_t written = 0; written < frame.size(); ) {
+          ssize_t n = send(fd, frame.data() + written, frame.size() - written,
+                           MSG_NOSIGNAL);
+
+          if (n < 0) {
+               if (errno == EINTR)
+                    continue;
+
+               return false;
+          }
+
+          written += n;
+     }
+
+     return true;
+}
+
+/* Answer a single request, using `board` and `results` as scratch
+ * space. */
+string answer_request(const string &request,
+                      solution_dictionary &dictionary,
+                      boggle_board &board,
+                      solve_results &results)
+{
+     size_t space = request.find(' ');
+     string command = request.substr(0, space);
+     string args = (space == string::npos) ? "" : request.substr(space + 1);
+     scanner in;
+     ostringstream out;
+
+     in.open(args.data(), args.size());
+
+     if (command == "solve") {
+          if (!(in >> board))
+               return "error Invalid board";
+
+          out << "ok ";
+          dictionary.solve(board, results, out);
+
+     } else if (command == "score") {
+          if (!(dictionary.use_graph && iterative_search))
+               return "error Scoring needs the iterative engine";
+
+          if (!(in >> board))
+               return "error Invalid board";
+
+          int points = dictionary.score(board, results);
+
+          out << "ok " << points << ' ' << results.ids.size();
+
+     } else if ((command == "add") || (command == "remove")
+                || (command == "reload")) {
+          if (!dictionary.versions)
+               return "error Changing words needs a word list and the recursive engine";
+
+          wordtree changed, none;
+          uint64_t version;
+
+          if (command == "reload") {
+               unique_lock<mutex> guard(reload_lock);
+
+               if (!reread_dictionary(changed))
+                    return "error Can't read dictionary";
+
+               version = dictionary.versions->replace(changed);
+          } else {
+               if (!(in >> changed))
+                    return "error Invalid word list";
+
+               if (command == "add")
+                    version = dictionary.versions->update(changed, none);
+               else
+                    version = dictionary.versions->update(none, changed);
+          }
+
+          out << "ok " << version;
+
+     } else if (command == "generate") {
+          int size = board_size;
+
+          in.skip_whitespace();
+
+          if ((in.peek() != EOF)
+              && (!in.read_int(size) || (size <= 0) || (size > MAX_GENERATE_SIZE)))
+               return "error Invalid size";
+
+          {
+               unique_lock<mutex> guard(generate_lock);
+
+               board.set_size(size);
+               board.shuffle();
+          }
+
+          out << "ok " << board;
+
+     } else
+          return "error Unknown request";
+
+     return out.str();
+}
+
+/* Answer the requests queued on `conn` until there are none left. If
+ * the client has hung up by then, close the connection. */
+void answer_requests(serve_connection *conn,
+                     solution_dictionary &dictionary,
+                     boggle_board &board,
+                     solve_results &results)
+{
+     for(;;) {
+          string request;
+          bool finished = false;
+
+          {
+               unique_lock<mutex> guard(conn->lock);
+
+               if (conn->requests.empty()) {
+                    conn->busy = false;
+
+                    if (!conn->closed)
+                         return;
+
+                    finished = true;
+               } else {
+                    request.swap(conn->requests.front());
+                    conn->requests.pop_front();
+               }
+          }
+
+          if (finished) {
+               close(conn->fd);
+               delete conn;
+               return;
+          }
+
+          write_frame(conn->fd, answer_request(request, dictionary, board, results));
+     }
+}
+
+/* Open a listening Unix socket at `path`, replacing any socket left
+ * behind there by an earlier run. */
+int open_serve_socket(const char *path)
+{
+     sockaddr_un address;
+     struct stat st;
+
+     memset(&address, 0, sizeof(address));
+     address.sun_family = AF_UNIX;
+
+     if (strlen(path) >= sizeof(address.sun_path))
+          error("Socket path too long.");
+
+     strcpy(address.sun_path, path);
+
+     if ((stat(path, &st) == 0) && S_ISSOCK(st.st_mode))
+          unlink(path);
+
+     int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+     if ((fd < 0)
+         || (bind(fd, (sockaddr *)&address, sizeof(address)) < 0)
+         || (listen(fd, SOMAXCONN) < 0))
+          error("Error opening socket.");
+
+     return fd;
+}
+
+/* Read what's waiting from `conn`, and queue each complete request in
+ * it. `start_job` is set if a job needs to be started to answer them.
+ * Returns false once the client has hung up, or sent something that
+ * can't be framed. */
+bool read_requests(serve_connection *conn, bool &start_job)
+{
+     char buf[65536];
+     ssize_t n = read(conn->fd, buf, sizeof(buf));
+
+     start_job = false;
+
+     if ((n < 0) && (errno == EINTR))
+          return true;
+
+     if (n <= 0)
+          return false;
+
+     conn->input.append(buf, n);
+
+     size_t used = 0;
+     deque<string> requests;
+
+     while (conn->input.size() - used >= sizeof(uint32_t)) {
+          uint32_t length;
+
+          memcpy(&length, conn->input.data() + used, sizeof(length));
+          length = ntohl(length);
+
+          if (length > MAX_FRAME_SIZE)
+               return false;
+
+          if (conn->input.size() - used - sizeof(length) < length)
+               break;
+
+          requests.push_back(conn->input.substr(used + sizeof(length), length));
+          used += sizeof(length) + length;
+     }
+
+     conn->input.erase(0, used);
+
+     if (requests.empty())
+          return true;
+
+     unique_lock<mutex> guard(conn->lock);
+
+     for(size_t i = 0; i < requests.size(); i++)
+          conn->requests.push_back(requests[i]);
+
+     start_job = !conn->busy;
+     conn->busy = true;
+
+     return true;
+}
+
+/* Answer requests from clients of the socket at `path` until the
+ * process is interrupted. The calling thread waits on the listening
+ * socket and every client at once, and reads and frames requests;
+ * answering them is left to the pool, with each worker solving into
+ * its own board and results. The calling thread is worker 0, and
+ * runs any jobs dealt to it between waits.
+ */
+void serve(const char *path, solution_dictionary &dictionary, thread_pool &pool)
+{
+     int workers = pool.thread_count();
+     boggle_board *boards = new boggle_board[workers];
+     solve_results *results = new solve_results[workers];
+     atomic<int> running_jobs(0);
+
+     for(int i = 0; i < workers; i++) {
+          dictionary.prepare(results[i]);
+          results[i].reader = i;
+     }
+
+     // A word list searched by the recursive engine can be changed
+     // while serving.
+     if (!dictionary.use_graph)
+          dictionary.versions = new word_versions(dictionary.words, workers);
+
+     struct sigaction action;
+
+     memset(&action, 0, sizeof(action));
+     action.sa_handler = stop_serving;
+     sigaction(SIGINT, &action, NULL);
+     sigaction(SIGTERM, &action, NULL);
+
+     vector<pollfd> fds;
+     vector<serve_connection *> connections;
+
+     fds.push_back({ open_serve_socket(path), POLLIN, 0 });
+     connections.push_back(NULL);
+
+     while (!serve_stopping) {
+          while (pool.run_one())
+               ;
+
+          if (poll(&fds[0], fds.size(), -1) < 0) {
+               if (errno == EINTR)
+                    continue;
+
+               error("Error waiting for requests.");
+          }
+
+          for(size_t i = fds.size() - 1; i > 0; i--) {
+               if (fds[i].revents == 0)
+                    continue;
+
+               serve_connection *conn = connections[i];
+               bool start_job;
+               bool open = read_requests(conn, start_job);
+
+               if (start_job) {
+                    running_jobs++;
+
+                    pool.submit([conn, boards, results, &dictionary,
+                                 &running_jobs](int worker) {
+                              answer_requests(conn, dictionary,
+                                              boards[worker], results[worker]);
+                              running_jobs--;
+                         });
+               }
+
+               if (open)
+                    continue;
+
+               bool finished;
+
+               {
+                    unique_lock<mutex> guard(conn->lock);
+
+                    conn->closed = true;
+                    finished = !conn->busy;
+               }
+
+               if (finished) {
+                    close(conn->fd);
+                    delete conn;
+               }
+
+               fds.erase(fds.begin() + i);
+               connections.erase(connections.begin() + i);
+          }
+
+          if (fds[0].revents & POLLIN) {
+               int fd = accept(fds[0].fd, NULL, NULL);
+
+               if (fd >= 0) {
+                    serve_connection *conn = new serve_connection;
+
+                    conn->fd = fd;
+                    conn->busy = false;
+                    conn->closed = false;
+
+                    fds.push_back({ fd, POLLIN, 0 });
+                    connections.push_back(conn);
+               }
+          }
+     }
+
+     close(fds[0].fd);
+     unlink(path);
+
+     // Let the jobs still answering requests finish before the
+     // dictionary and scratch space go away.
+     while (pool.run_one() || (running_jobs > 0))
+          this_thread::yield();
+
+     delete dictionary.versions;
+     dictionary.versions = NULL;
+
+     delete [] results;
+     delete [] boards;
+}
+
+/* Boards are generated in rounds. Each round is split into chunks of
+ * this many boards, handed out to the solver threads, and then written
+ * out in order. */
+const int GENERATE_CHUNK_SIZE = 256;
+
+/* Solve `board` and return TRUE if it meets the --min-words and
+ * --min-score limits. */
+bool board_qualifies(boggle_board &board,
+                     solution_dictionary &dictionary,
+                     solve_results &results)
+{
+     int points = dictionary.score(board, results);
+
+     return (results.ids.size() >= min_words) && (points >= min_score);
+}
+
+/* Write `count` boards to standard output, one per line. Board i of
+ * the candidates is filled from counter_random(seed, i), so the output
+ * depends only on the seed. If `dictionary` is given, candidates that
+ * don't meet the --min-words and --min-score limits are skipped, and
+ * the boards written are the first `count` that do.
+ */
+void generate_boards(long count,
+                     uint64_t seed,
+                     solution_dictionary *dictionary,
+                     thread_pool &pool)
+{
+     int workers = pool.thread_count();
+     int chunks = 4 * workers;
+     boggle_board *boards = new boggle_board[workers];
+     solve_results *results = new solve_results[workers];
+     vector<string> output(chunks);
+     vector<long> output_count(chunks);
+     uint64_t first = 0;
+
+     for(int i = 0; i < workers; i++) {
+          boards[i].set_size(board_size);
+
+          if (dictionary)
+               dictionary->prepare(results[i]);
+     }
+
+     while (count > 0) {
+          pool.run(chunks, [&](int worker, int chunk) {
+                    boggle_board &board = boards[worker];
+                    uint64_t index = first + (uint64_t)chunk * GENERATE_CHUNK_SIZE;
+                    ostringstream out;
+
+                    output_count[chunk] = 0;
+
+                    for(int i = 0; i < GENERATE_CHUNK_SIZE; i++, index++) {
+                         counter_random random(seed, index);
+
+                         board.shuffle(random);
+
+                         if (dictionary
+                             && !board_qualifies(board, *dictionary,
+                                                 results[worker]))
+                              continue;
+
+                         out << board << '\n';
+                         output_count[chunk]++;
+                    }
+
+                    output[chunk] = out.str();
+               });
+
+          for(int chunk = 0; (chunk < chunks) && (count > 0); chunk++) {
+               if (output_count[chunk] <= count) {
+                    cout << output[chunk];
+                    count -= output_count[chunk];
+                    continue;
+               }
+
+               // Only part of this chunk is needed to finish.
+               size_t end = 0;
+
+               for(; count > 0; count--)
+                    end = output[chunk].find('\n', end) + 1;
+
+               cout.write(output[chunk].data(), end);
+          }
+
+          first += (uint64_t)chunks * GENERATE_CHUNK_SIZE;
+     }
+
+     cout.flush();
+
+     delete [] results;
+     delete [] boards;
+}
+
+/* Search for the best board of the --size given, and write it and
+ * its score. With --stats, the number of steps taken and how fast
+ * they went are written to standard error, as JSON. */
+void optimize(solution_dictionary &dictionary, thread_pool &pool)
+{
+     optimizer_dictionary od(dictionary.graph, scoring);
+     boggle_board best;
+     int chains = (chain_count > 0) ? chain_count : pool.thread_count();
+
+     for(size_t i = 0; i < dictionary.ignored_ids.size(); i++)
+          od.ignore(dictionary.ignored_ids[i]);
+
+     chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+     int score = optimize_board(od, board_size, board_size,
+                                chains, optimize_steps,
+                                (seed == -1) ? time(0) : seed,
+                                pool, best);
+
+     double optimize_ms = elapsed_ms(start);
+
+     cout << best << endl << score << endl;
+
+     if (show_stats)
+          cerr << "{\"chains\": " << chains
+               << ", \"steps\": " << (long)chains * optimize_steps
+               << ", \"optimize_ms\": " << optimize_ms
+               << ", \"steps_per_sec\": "
+               << ((long)chains * optimize_steps) / (optimize_ms / 1000.0)
+               << "}" << endl;
+}
+
+/* Read the progress of an exhaustive search from checkpoint_file, if
+ * there's anything to read, marking the tasks already finished in
+ * `done`, and leaving the best board found in `best`. Returns that
+ * board's score, or -1 if there isn't one. The checkpoint starts
+ * with a header naming the size of the boards searched, and then has
+ * a line for each task finished, and for each better board found.
+ */
+int read_checkpoint(vector<bool> &done, boggle_board &best)
+{
+     ifstream in(checkpoint_file);
+     string tag;
+     int xsize, ysize, tasks, best_score = -1;
+
+     if (!in)
+          return -1;
+
+     if (!(in >> tag >> xsize >> ysize >> tasks))
+          return -1;
+
+     if ((tag != "boggler-checkpoint") || (tasks != CLASS_TASKS))
+          error("Invalid checkpoint file.");
+
+     if ((xsize != board_size) || (ysize != board_size))
+          error("Checkpoint file is for another board size.");
+
+     // A line cut short by the search being stopped is ignored.
+     while (in >> tag) {
+          if (tag == "done") {
+               int task;
+
+               if ((in >> task) && (task >= 0) && (task < CLASS_TASKS))
+                    done[task] = true;
+          } else if (tag == "best") {
+               int score;
+               string letters;
+
+               if ((in >> score >> letters)
+                   && ((int)letters.size() == board_size * board_size)) {
+                    best_score = score;
+                    best.set_size(board_size);
+
+                    for(int i = 0; i < board_size * board_size; i++)
+                         best.set(1 + i / board_size, 1 + i % board_size,
+                                  letters[i]);
+               }
+          }
+     }
+
+     return best_score;
+}
+
+/* Search every board of the --size given for the best one, and write
+ * it and its score. With --checkpoint, progress is appended to the
+ * checkpoint file as each task finishes, and an earlier search
+ * recorded there is carried on. With --stats, the number of classes
+ * bounded and the time taken are written to standard error, as JSON.
+ */
+void search_exhaustive(solution_dictionary &dictionary, thread_pool &pool)
+{
+     optimizer_dictionary od(dictionary.graph, scoring);
+     boggle_board best;
+     vector<bool> done(CLASS_TASKS, false);
+     int best_score = (min_score > 0) ? min_score - 1 : 0;
+     int tasks_done = 0;
+     long classes_bounded = 0;
+     ofstream checkpoint;
+
+     if (board_size * board_size > 32)
+          error("Exhaustive search is limited to boards of 32 cells");
+
+     for(size_t i = 0; i < dictionary.ignored_ids.size(); i++)
+          od.ignore(dictionary.ignored_ids[i]);
+
+     if (checkpoint_file) {
+          int score = read_checkpoint(done, best);
+
+          if (score > best_score)
+               best_score = score;
+
+          bool fresh = (score < 0) && (count(done.begin(), done.end(), true) == 0);
+
+          checkpoint.open(checkpoint_file, fresh ? ios::out : ios::app);
+
+          if (!checkpoint)
+               error("Error writing checkpoint file.");
+
+          if (fresh)
+               checkpoint << "boggler-checkpoint " << board_size << ' '
+                          << board_size << ' ' << CLASS_TASKS << '\n';
+     }
+
+     int last_score = best_score;
+     chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+     int score = search_board_classes(od, board_size, board_size,
+                                      best_score, best, done, pool,
+                                      [&](int task, int score,
+                                          boggle_board &board) {
+               tasks_done++;
+
+               if (!checkpoint_file)
+                    return;
+
+               if (score > last_score) {
+                    checkpoint << "best " << score << ' ';
+
+                    for(int i = 0; i < board_size * board_size; i++)
+                         checkpoint << board.ref(1 + i / board_size,
+                                                 1 + i % board_size);
+
+                    checkpoint << '\n';
+                    last_score = score;
+               }
+
+               checkpoint << "done " << task << endl;
+          }, &classes_bounded);
+
+     double search_ms = elapsed_ms(start);
+
+     if (best.xsize() == board_size)
+          cout << best << endl << score << endl;
+     else
+          warn("No board scores at least the minimum score");
+
+     if (show_stats)
+          cerr << "{\"tasks\": " << tasks_done
+               << ", \"classes_bounded\": " << classes_bounded
+               << ", \"search_ms\": " << search_ms << "}" << endl;
+}
+
+/* Execute the operations requested by the user */
+void do_command()
+{
+     if (help) {
+          cout << help_text << endl;
+          return;
+     }
+
+     if (compiled_dict_file) {
+          compile_dictionary();
+          return;
+     }
+
+     if (profile_file)
+          error("Profile boards can only be used with --compile-dictionary");
+
+     thread_pool pool(thread_count);
+
+     // Boards are only scored, split into tiles, or solved against
+     // several lexicons by the iterative search.
+     if (score_only || (tile_size > 0) || !lexicon_files.empty())
+          iterative_search = true;
+
+     if (!lexicon_files.empty()
+         && (solution_dict_file || serve_socket || (generate_count > 0)
+             || (optimize_steps > 0) || (tile_size > 0) || exhaustive))
+          error("Lexicons can only be used in place of -d to solve boards");
+
+     if (generate_count > 0) {
+          solution_dictionary dictionary;
+          bool filtered = (min_words > 0) || (min_score > 0);
+
+          if (filtered) {
+               if (!solution_dict_file)
+                    error("No dictionary file specified to filter boards");
+
+               // Candidates are checked with the iterative search.
+               iterative_search = true;
+               dictionary.load();
+          }
+
+          generate_boards(generate_count, (seed == -1) ? time(0) : seed,
+                          filtered ? &dictionary : NULL, pool);
+
+          return;
+     }
+
+     if (optimize_steps > 0) {
+          solution_dictionary dictionary;
+
+          if (!solution_dict_file)
+               error("No dictionary file specified to score boards");
+
+          // Boards are scored against the minimized dictionary.
+          iterative_search = true;
+          dictionary.load();
+          optimize(dictionary, pool);
+
+          return;
+     }
+
+     if (exhaustive) {
+          solution_dictionary dictionary;
+
+          if (!solution_dict_file)
+               error("No dictionary file specified to score boards");
+
+          iterative_search = true;
+          dictionary.load();
+          search_exhaustive(dictionary, pool);
+
+          return;
+     }
+
+     if (serve_socket) {
+          solution_dictionary dictionary;
+
+          if (!solution_dict_file)
+               error("No dictionary file specified to serve");
+
+          // Generated boards are random unless a seed is given.
+          srand((seed == -1) ? time(0) : seed);
+
+          dictionary.load();
+          serve(serve_socket, dictionary, pool);
+
+          return;
+     }
+
+     if (batch_file) {
+          solution_dictionary dictionary;
+
+          if (!solution_dict_file && lexicon_files.empty())
+               error("No dictionary file specified to solve the batch");
+
+          dictionary.load();
+
+          scanner batch_in;
+          scanner *in = open_input(batch_file, batch_in);
+
+          if (in == NULL)
+               error("Error reading batch file.");
+
+          if (thread_count > 1)
+               solve_batch(*in, dictionary, pool);
+          else
+               solve_batch(*in, dictionary);
+
+          return;
+     }
+
+     boggle_board board;
+
+     // Initalize the random number generator
+     srand((seed == -1) ? time(0) : seed);
+
+     // Generate or load a puzzle board.
+     if (generate_puzzle) {
+          board.set_size(board_size);
+          board.shuffle();
+
+     } else if (puzzle_file) {
+          read_input(puzzle_file, board, "puzzle file");
+
+     } else
+          warn("No valid puzzle specified");
+
+     // write the puzzle board in use.
+     if (write_puzzle)
+          cout << board << endl;
+
+     // Solve the puzzle board, if requested.
+
+     if (solution_dict_file || !lexicon_files.empty()) {
+          solution_dictionary dictionary;
+          solve_results results;
+
+          dictionary.load();
+          dictionary.prepare(results);
+
+          if (tile_size > 0)
+               dictionary.solve_tiles(board, results, cout, pool);
+          else
+               dictionary.solve(board, results, cout, &pool);
+
+          cout << endl;
+
+          if (show_stats)
+               write_stats(results);
+     }
+}
+
+int main(int argc, char *argv[])
+{
+  // Parse the command line options
+  parse_options(argc, argv);
+
+  // Execute the requested command
+  do_command();
+
+  // Delete the dynamic storage used by the command line options
+  free(solution_dict_file);
+  free(puzzle_file);
+  free(ignore_file);
+  free(compiled_dict_file);
+  free(batch_file);
+  free(serve_socket);
+  free(checkpoint_file);
+  free(profile_file);
+
+  for(size_t i = 0; i < lexicon_files.size(); i++)
+    free(lexicon_files[i]);
 
   return 0;
 }
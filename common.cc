@@ -23,6 +23,30 @@ int limited_random(int limit)
   return (rand() % limit);
 }
 
+counter_random::counter_random(uint64_t seed, uint64_t stream)
+{
+  _state = seed;
+  _state = next() ^ stream;
+  _state = next();
+}
+
+/* Produce a random integer in the range [0, limit), without the bias
+ * of taking a remainder. The top bits of a product are used, and the
+ * few low products that would favor some results are drawn again. */
+int counter_random::limited(int limit)
+{
+  uint64_t product = (next() & 0xffffffffULL) * (uint32_t)limit;
+
+  if ((uint32_t)product < (uint32_t)limit) {
+    uint32_t threshold = -(uint32_t)limit % (uint32_t)limit;
+
+    while ((uint32_t)product < threshold)
+      product = (next() & 0xffffffffULL) * (uint32_t)limit;
+  }
+
+  return product >> 32;
+}
+
 /* Skip all whitespace on the input stream, leaving it positioned
  * at the first non-whitespace character. */
 void skip_whitespace(istream &i)
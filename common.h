@@ -16,6 +16,7 @@
 #ifndef __COMMON_H
 #define __COMMON_H
 
+#include <stdint.h>
 #include <iostream>
 
 using namespace std;
@@ -25,6 +26,33 @@ const int PREFIX_BUF_SIZE = 32;
 
 int limited_random(int);
 
+/* A counter_random produces a stream of random numbers from a seed and
+ * a stream number, such as the index of a board. Each number is a hash
+ * of the seed, the stream and a counter, so the stream for any index
+ * can be made directly, on any thread, and gives the same numbers
+ * however the work is split up. This is SplitMix64 with its state
+ * derived from the stream. */
+class counter_random {
+public:
+  counter_random(uint64_t seed, uint64_t stream);
+
+  uint64_t next();
+  int limited(int limit);
+
+private:
+  uint64_t _state;
+};
+
+inline uint64_t counter_random::next()
+{
+  uint64_t z = (_state += 0x9e3779b97f4a7c15ULL);
+
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+  return z ^ (z >> 31);
+}
+
 void skip_whitespace(istream &);
 int expect(istream &, char);
 
@@ -0,0 +1,823 @@
+// Copyright (c) Mike Schaeffer. All rights reserved.
+//
+// The use and distribution terms for this software are covered by the
+// Eclipse Public License 2.0 (https://opensource.org/licenses/EPL-2.0)
+// which can be found in the file LICENSE at the root of this distribution.
+// By using this software in any fashion, you are agreeing to be bound by
+// the terms of this license.
+//
+// You must not remove this notice, or any other, from this software.
+
+/*
+ * dawg.cc - Minimized directed acyclic word graph
+ * by Michael Schaeffer
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <fstream>
+
+#include "common.h"
+#include "wordtree.h"
+#include "dawg.h"
+
+/* Scratch state used while minimizing a wordtree. Each distinct
+ * subtree is registered under a signature made of its word flag
+ * followed by its outgoing (letter, child id) pairs. Since children
+ * are registered before their parents, two subtrees accepting the
+ * same suffixes always produce the same signature, and are merged.
+ */
+struct dawg_builder {
+  unordered_map<string, uint32_t> registry;
+  vector<string> signatures;
+  vector<uint32_t> word_counts;   // The words below each subtree
+  vector<uint32_t> needs;         // The letters they all need, as bits
+  vector<uint32_t> needs_twice;   // ... and those they all need twice
+
+  uint32_t add(wordtree::iterator i);
+};
+
+uint32_t dawg_builder::add(wordtree::iterator i)
+{
+  string signature(1, i.is_word() ? '1' : '0');
+  uint32_t word_count = i.is_word() ? 1 : 0;
+  uint32_t need = i.is_word() ? 0 : UINT32_MAX;
+  uint32_t need_twice = need;
+
+  for(char ch = 'a'; ch <= 'z'; ch++)
+    if (i.letter_exists(ch)) {
+      uint32_t child = add(i.letter(ch));
+      uint32_t bit = 1 << (ch - 'a');
+
+      signature += ch;
+      signature.append((char *)&child, sizeof(child));
+      word_count += word_counts[child];
+
+      // A letter is needed only if it's needed on every edge.
+      need &= needs[child] | bit;
+      need_twice &= needs_twice[child] | (needs[child] & bit);
+    }
+
+  unordered_map<string, uint32_t>::iterator existing = registry.find(signature);
+
+  if (existing != registry.end())
+    return existing->second;
+
+  uint32_t id = signatures.size();
+
+  signatures.push_back(signature);
+  word_counts.push_back(word_count);
+  needs.push_back(need);
+  needs_twice.push_back(need_twice);
+  registry[signature] = id;
+
+  return id;
+}
+
+const char dawg::IMAGE_MAGIC[8] = { 'B', 'O', 'G', 'D', 'A', 'W', 'G', '\0' };
+
+dawg::dawg()
+{
+  _nodes = NULL;
+  _edges = NULL;
+  _edge_word_offsets = NULL;
+  _node_count = 0;
+  _edge_count = 0;
+  _word_count = 0;
+
+  _image = NULL;
+  _image_size = 0;
+}
+
+dawg::~dawg()
+{
+  release();
+}
+
+/* Drop the current contents of the dawg, unmapping its image if it
+ * was loaded from one. */
+void dawg::release()
+{
+  if (_image)
+    munmap(_image, _image_size);
+
+  _image = NULL;
+  _image_size = 0;
+
+  _node_store.clear();
+  _edge_store.clear();
+  _edge_word_offset_store.clear();
+
+  _nodes = NULL;
+  _edges = NULL;
+  _edge_word_offsets = NULL;
+  _node_count = 0;
+  _edge_count = 0;
+  _word_count = 0;
+}
+
+/* Replace the contents of the dawg with a minimized copy of the words
+ * in `wt`. Nodes are renumbered breadth-first from the root so that
+ * the upper levels of the graph, which every search touches, are
+ * packed together at the front of the node and edge arrays.
+ */
+void dawg::build(wordtree &wt)
+{
+  dawg_builder builder;
+  uint32_t root = builder.add(wordtree::iterator(wt));
+
+  vector<uint32_t> new_id(builder.signatures.size(), UINT32_MAX);
+  vector<uint32_t> queue;
+
+  release();
+
+  new_id[root] = 0;
+  queue.push_back(root);
+
+  for(size_t head = 0; head < queue.size(); head++) {
+    const string &signature = builder.signatures[queue[head]];
+    dawg_node node;
+
+    node._first_edge = _edge_store.size();
+    node._edge_count = 0;
+    node._is_word = (signature[0] == '1');
+    node._reserved = 0;
+    node._needs = builder.needs[queue[head]];
+    node._needs_twice = builder.needs_twice[queue[head]];
+
+    uint32_t word_offset = node._is_word ? 1 : 0;
+
+    for(size_t pos = 1; pos < signature.size(); pos += 1 + sizeof(uint32_t)) {
+      char letter = signature[pos];
+      uint32_t child;
+
+      memcpy(&child, signature.data() + pos + 1, sizeof(child));
+
+      if (new_id[child] == UINT32_MAX) {
+        new_id[child] = queue.size();
+        queue.push_back(child);
+      }
+
+      _edge_store.push_back((new_id[child] << EDGE_LETTER_BITS) | (letter - 'a'));
+      _edge_word_offset_store.push_back(word_offset);
+      node._edge_count++;
+
+      word_offset += builder.word_counts[child];
+    }
+
+    _node_store.push_back(node);
+  }
+
+  _nodes = &_node_store[0];
+  _edges = _edge_store.empty() ? NULL : &_edge_store[0];
+  _edge_word_offsets = _edge_store.empty() ? NULL : &_edge_word_offset_store[0];
+  _node_count = _node_store.size();
+  _edge_count = _edge_store.size();
+  _word_count = builder.word_counts[root];
+}
+
+/* Lay the node and edge arrays out again for a search that visited
+ * each node the number of times given in `visits`, numbering the
+ * nodes in a new order. The top HOT_LEVELS levels of nodes that were
+ * visited at all come first, breadth-first, as build() leaves them.
+ * Below those, each visited subtree is laid out depth-first, hottest
+ * child first, with each node's children side by side, so a search
+ * going down a path finds the next node close by. Nodes that were
+ * never visited go at the end. The words and their ids don't change.
+ */
+void dawg::reorder(const vector<uint64_t> &visits)
+{
+  assert(visits.size() == _node_count);
+
+  vector<uint32_t> new_id(_node_count, UINT32_MAX);
+  vector<uint32_t> order;         // The old node numbers, in new order
+  size_t level_start = 0;
+
+  new_id[root()] = 0;
+  order.push_back(root());
+
+  for(int depth = 1; depth < HOT_LEVELS; depth++) {
+    size_t level_end = order.size();
+
+    for(size_t i = level_start; i < level_end; i++)
+      for(uint32_t edge = first_edge(order[i]); edge < end_edge(order[i]); edge++) {
+        uint32_t child = edge_target(edge);
+
+        if (visits[child] && (new_id[child] == UINT32_MAX)) {
+          new_id[child] = order.size();
+          order.push_back(child);
+        }
+      }
+
+    level_start = level_end;
+  }
+
+  size_t hot_top = order.size();
+
+  for(size_t i = 0; i < hot_top; i++)
+    place_subtree(order[i], visits, new_id, order);
+
+  for(uint32_t node = 0; node < _node_count; node++)
+    if (new_id[node] == UINT32_MAX) {
+      new_id[node] = order.size();
+      order.push_back(node);
+    }
+
+  vector<dawg_node> nodes;
+  vector<dawg_edge> edges;
+  vector<uint32_t> offsets;
+
+  nodes.reserve(_node_count);
+  edges.reserve(_edge_count);
+  offsets.reserve(_edge_count);
+
+  for(size_t i = 0; i < order.size(); i++) {
+    dawg_node node = _nodes[order[i]];
+
+    node._first_edge = edges.size();
+
+    for(uint32_t edge = first_edge(order[i]); edge < end_edge(order[i]); edge++) {
+      edges.push_back((new_id[edge_target(edge)] << EDGE_LETTER_BITS)
+                      | edge_letter(edge));
+      offsets.push_back(edge_word_offset(edge));
+    }
+
+    nodes.push_back(node);
+  }
+
+  uint32_t word_count = _word_count;
+
+  release();
+
+  _node_store.swap(nodes);
+  _edge_store.swap(edges);
+  _edge_word_offset_store.swap(offsets);
+
+  _nodes = &_node_store[0];
+  _edges = _edge_store.empty() ? NULL : &_edge_store[0];
+  _edge_word_offsets = _edge_store.empty() ? NULL : &_edge_word_offset_store[0];
+  _node_count = _node_store.size();
+  _edge_count = _edge_store.size();
+  _word_count = word_count;
+}
+
+/* Number the visited children of `node` that have no number yet, one
+ * after another, and then lay out each of their subtrees the same
+ * way, starting with the most visited child. */
+void dawg::place_subtree(uint32_t node,
+                         const vector<uint64_t> &visits,
+                         vector<uint32_t> &new_id,
+                         vector<uint32_t> &order)
+{
+  vector<uint32_t> children;
+
+  for(uint32_t edge = first_edge(node); edge < end_edge(node); edge++) {
+    uint32_t child = edge_target(edge);
+
+    if (visits[child] && (new_id[child] == UINT32_MAX)) {
+      new_id[child] = order.size();
+      order.push_back(child);
+      children.push_back(child);
+    }
+  }
+
+  sort(children.begin(), children.end(),
+       [&](uint32_t a, uint32_t b) { return visits[a] > visits[b]; });
+
+  for(size_t i = 0; i < children.size(); i++)
+    place_subtree(children[i], visits, new_id, order);
+}
+
+int dawg::node_count()
+{
+  return _node_count;
+}
+
+int dawg::edge_count()
+{
+  return _edge_count;
+}
+
+int dawg::word_count()
+{
+  return _word_count;
+}
+
+/* Return the length of the longest word in the dawg. */
+int dawg::longest_word()
+{
+  vector<int> lengths(_node_count, -1);
+
+  return (_node_count > 0) ? longest_word(root(), lengths) : 0;
+}
+
+/* Return the length of the longest suffix of a word below `node`,
+ * noting the length for every node in `lengths`, so that no node is
+ * visited twice. */
+int dawg::longest_word(uint32_t node, vector<int> &lengths)
+{
+  if (lengths[node] < 0) {
+    lengths[node] = 0;
+
+    for(uint32_t edge = first_edge(node); edge < end_edge(node); edge++)
+      lengths[node] = max(lengths[node],
+                          1 + longest_word(edge_target(edge), lengths));
+  }
+
+  return lengths[node];
+}
+
+/* Return the id of `word`, or NO_WORD if it isn't in the dawg. */
+uint32_t dawg::word_id(const char *word)
+{
+  uint32_t node = root();
+  uint32_t id = 0;
+
+  for(const char *ch = word; *ch != '\0'; ch++) {
+    if ((*ch < 'a') || (*ch > 'z'))
+      return NO_WORD;
+
+    uint32_t edge;
+
+    for(edge = first_edge(node); edge < end_edge(node); edge++)
+      if (edge_letter(edge) == *ch - 'a')
+        break;
+
+    if (edge == end_edge(node))
+      return NO_WORD;
+
+    id += edge_word_offset(edge);
+    node = edge_target(edge);
+  }
+
+  return is_word(node) ? id : NO_WORD;
+}
+
+/* Copy the word with the given id into `buf`, which must hold at
+ * least MAX_WORD_SIZE characters. Returns false if there is no such
+ * word. */
+bool dawg::word(uint32_t id, char *buf)
+{
+  uint32_t node = root();
+  uint32_t base = 0;
+  int length = 0;
+
+  if (id >= _word_count)
+    return false;
+
+  while (!(is_word(node) && (base == id))) {
+    uint32_t edge = first_edge(node);
+
+    // Follow the last edge whose first word id isn't past `id`.
+    while ((edge + 1 < end_edge(node))
+           && (base + edge_word_offset(edge + 1) <= id))
+      edge++;
+
+    if ((edge == end_edge(node)) || (length == MAX_WORD_SIZE - 1))
+      return false;
+
+    buf[length++] = 'a' + edge_letter(edge);
+    base += edge_word_offset(edge);
+    node = edge_target(edge);
+  }
+
+  buf[length] = '\0';
+
+  return true;
+}
+
+/* Add the ids of the words in `words` that are also in the dawg to
+ * `ids`. */
+void dawg::word_ids(wordtree &words, vector<uint32_t> &ids)
+{
+  word_ids(wordtree::iterator(words), ids);
+}
+
+void dawg::word_ids(wordtree::iterator i, vector<uint32_t> &ids)
+{
+  if (i.is_word()) {
+    uint32_t id = word_id(i());
+
+    if (id != NO_WORD)
+      ids.push_back(id);
+  }
+
+  for(char ch = 'a'; ch <= 'z'; ch++)
+    if (i.letter_exists(ch))
+      word_ids(i.letter(ch), ids);
+}
+
+/* Write the words in `words` in the same form, and alphabetical
+ * order, as writing a wordtree. */
+void dawg::write_words(ostream &o, word_set &words)
+{
+  char buf[MAX_WORD_SIZE];
+
+  sort(words.ids().begin(), words.ids().end());
+
+  o << "{";
+
+  for(size_t i = 0; i < words.ids().size(); i++)
+    if (word(words.ids()[i], buf))
+      o << buf << ' ';
+
+  o << "}";
+}
+
+/* Write the words in `words` that are in lexicon number `lexicon`,
+ * as write_words does. */
+void dawg::write_words(ostream &o, word_set &words, uint32_t lexicon,
+                       const lexicon_masks &lexicons)
+{
+  char buf[MAX_WORD_SIZE];
+  uint32_t bit = 1U << lexicon;
+
+  sort(words.ids().begin(), words.ids().end());
+
+  o << "{";
+
+  for(size_t i = 0; i < words.ids().size(); i++)
+    if ((lexicons.mask(words.ids()[i]) & bit) && word(words.ids()[i], buf))
+      o << buf << ' ';
+
+  o << "}";
+}
+
+/* A 64-bit FNV-1a style hash, taken a word at a time so that
+ * checking an image on load stays cheap. Pass the result of one call
+ * as `hash` to continue hashing across several buffers. */
+uint64_t dawg::checksum(const void *data, size_t length, uint64_t hash)
+{
+  const uint32_t *words = (const uint32_t *)data;
+
+  assert(length % sizeof(uint32_t) == 0);
+
+  for(size_t i = 0; i < length / sizeof(uint32_t); i++) {
+    hash ^= words[i];
+    hash *= 0x100000001b3ULL;
+  }
+
+  return hash;
+}
+
+/* Write the dawg to `filename` as a flat image that map_image can
+ * load back without parsing. */
+bool dawg::write_image(const char *filename)
+{
+  image_header header;
+  size_t node_bytes = _node_count * sizeof(dawg_node);
+  size_t edge_bytes = _edge_count * sizeof(dawg_edge);
+  size_t offset_bytes = _edge_count * sizeof(uint32_t);
+
+  memcpy(header._magic, IMAGE_MAGIC, sizeof(header._magic));
+  header._version = IMAGE_VERSION;
+  header._node_count = _node_count;
+  header._edge_count = _edge_count;
+  header._word_count = _word_count;
+  header._checksum =
+    checksum(_edge_word_offsets, offset_bytes,
+             checksum(_edges, edge_bytes,
+                      checksum(_nodes, node_bytes)));
+
+  ofstream out(filename, ios::binary);
+
+  out.write((const char *)&header, sizeof(header));
+  out.write((const char *)_nodes, node_bytes);
+  out.write((const char *)_edges, edge_bytes);
+  out.write((const char *)_edge_word_offsets, offset_bytes);
+
+  return (bool)out;
+}
+
+/* Return true if `filename` names a dictionary image rather than a
+ * text word list. */
+bool dawg::is_image(const char *filename)
+{
+  char magic[sizeof(IMAGE_MAGIC)];
+
+  if (strcmp(filename, "-") == 0)
+    return false;
+
+  ifstream in(filename, ios::binary);
+
+  if (!in.read(magic, sizeof(magic)))
+    return false;
+
+  return memcmp(magic, IMAGE_MAGIC, sizeof(magic)) == 0;
+}
+
+/* Map a dictionary image read-only into memory and use it in place.
+ * Processes mapping the same image share its pages. Returns false,
+ * leaving the dawg empty, if the image is missing or damaged.
+ */
+bool dawg::map_image(const char *filename)
+{
+  struct stat st;
+
+  release();
+
+  int fd = open(filename, O_RDONLY);
+
+  if (fd < 0)
+    return false;
+
+  if ((fstat(fd, &st) < 0) || ((size_t)st.st_size < sizeof(image_header))) {
+    close(fd);
+    return false;
+  }
+
+  void *image = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+  close(fd);
+
+  if (image == MAP_FAILED)
+    return false;
+
+  _image = image;
+  _image_size = st.st_size;
+
+  if (!validate()) {
+    release();
+    return false;
+  }
+
+  return true;
+}
+
+/* Check the header, size, checksum, and internal references of a
+ * freshly mapped image, and point the node and edge arrays into it. */
+bool dawg::validate()
+{
+  const image_header *header = (const image_header *)_image;
+
+  if (memcmp(header->_magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0)
+    return false;
+
+  if (header->_version != IMAGE_VERSION)
+    return false;
+
+  size_t node_bytes = (size_t)header->_node_count * sizeof(dawg_node);
+  size_t edge_bytes = (size_t)header->_edge_count * sizeof(dawg_edge);
+  size_t offset_bytes = (size_t)header->_edge_count * sizeof(uint32_t);
+
+  if ((header->_node_count == 0)
+      || (sizeof(image_header) + node_bytes + edge_bytes + offset_bytes
+          != _image_size))
+    return false;
+
+  const char *body = (const char *)_image + sizeof(image_header);
+  const dawg_node *nodes = (const dawg_node *)body;
+  const dawg_edge *edges = (const dawg_edge *)(body + node_bytes);
+  const uint32_t *offsets = (const uint32_t *)(body + node_bytes + edge_bytes);
+
+  if (header->_checksum
+      != checksum(offsets, offset_bytes,
+                  checksum(edges, edge_bytes,
+                           checksum(nodes, node_bytes))))
+    return false;
+
+  for(uint32_t i = 0; i < header->_node_count; i++)
+    if (((uint64_t)nodes[i]._first_edge + nodes[i]._edge_count
+         > header->_edge_count)
+        || (nodes[i]._needs_twice & ~nodes[i]._needs))
+      return false;
+
+  for(uint32_t i = 0; i < header->_edge_count; i++)
+    if (((edges[i] >> EDGE_LETTER_BITS) >= header->_node_count)
+        || ((edges[i] & EDGE_LETTER_MASK) >= 26)
+        || (offsets[i] > header->_word_count))
+      return false;
+
+  _nodes = nodes;
+  _edges = edges;
+  _edge_word_offsets = offsets;
+  _node_count = header->_node_count;
+  _edge_count = header->_edge_count;
+  _word_count = header->_word_count;
+
+  return true;
+}
+
+/* Dump the graph structure for debugging purposes. */
+void dawg::dump()
+{
+  for(uint32_t i = 0; i < _node_count; i++) {
+    const dawg_node &node = _nodes[i];
+
+    if (node._is_word)
+      cout << i << " *(";
+    else
+      cout << i << "  (";
+
+    for(int j = 0; j < node._edge_count; j++) {
+      dawg_edge edge = _edges[node._first_edge + j];
+
+      cout << (char)('a' + (edge & EDGE_LETTER_MASK)) << ", "
+           << (edge >> EDGE_LETTER_BITS) << "; ";
+    }
+
+    cout << ")" << endl;
+  }
+}
+
+/* Create a new traversal iterator rooted at the base of a dawg,
+ * using the specified string as a prefix.
+ */
+dawg::iterator::iterator(dawg &d, char *prefix)
+{
+  assert(d._node_count > 0);
+
+  _dawg = &d;
+  _current_node = 0;
+
+  _prefix[0] = '\0';
+
+  if (prefix)
+    strncpy(_prefix, prefix, PREFIX_BUF_SIZE - 1);
+
+  _prefix[PREFIX_BUF_SIZE - 1] = '\0';
+}
+
+/* Create a new traversal iterator at `node`, whose prefix is `prefix`
+ * followed by the letter used to reach it.
+ */
+dawg::iterator::iterator(dawg *d, uint32_t node, char *prefix, char letter)
+{
+  _dawg = d;
+  _current_node = node;
+
+  strncpy(_prefix, prefix, PREFIX_BUF_SIZE - 1);
+  _prefix[PREFIX_BUF_SIZE - 1] = '\0';
+
+  int length = strlen(_prefix);
+
+  if (length < PREFIX_BUF_SIZE - 1) {
+    _prefix[length] = letter;
+    _prefix[length + 1] = '\0';
+  }
+}
+
+/* Return the index of the edge leaving the current node on `letter`,
+ * or -1 if there is no such edge.
+ */
+int dawg::iterator::find_edge(char letter)
+{
+  if (letter < 'a' || letter > 'z')
+    return -1;
+
+  const dawg_node &node = _dawg->_nodes[_current_node];
+  dawg_edge letter_bits = letter - 'a';
+
+  for(int i = 0; i < node._edge_count; i++) {
+    dawg_edge edge = _dawg->_edges[node._first_edge + i];
+
+    if ((edge & EDGE_LETTER_MASK) == letter_bits)
+      return node._first_edge + i;
+  }
+
+  return -1;
+}
+
+/* Determine if a letter is a valid continuation of the prefix. */
+bool dawg::iterator::letter_exists(char letter)
+{
+  return find_edge(letter) >= 0;
+}
+
+/* Return the letters that continue the prefix, as bits, with 'a' as
+ * bit 0. */
+uint32_t dawg::iterator::letters()
+{
+  const dawg_node &node = _dawg->_nodes[_current_node];
+  uint32_t letters = 0;
+
+  for(int i = 0; i < node._edge_count; i++)
+    letters |= 1 << (_dawg->_edges[node._first_edge + i] & EDGE_LETTER_MASK);
+
+  return letters;
+}
+
+/* Determine if the iterator represents a traversal of a valid word. */
+bool dawg::iterator::is_word()
+{
+  return _dawg->_nodes[_current_node]._is_word;
+}
+
+/* Return a pointer to the current prefix.  This string must be
+ * used before the iterator is destructed.
+ */
+char *dawg::iterator::operator()()
+{
+  return _prefix;
+}
+
+/* Return a new traversal iterator rooted at the specified letter. */
+dawg::iterator dawg::iterator::letter(char letter)
+{
+  int edge = find_edge(letter);
+
+  assert(edge >= 0);
+
+  return iterator(_dawg,
+                  _dawg->_edges[edge] >> EDGE_LETTER_BITS,
+                  _prefix,
+                  letter);
+}
+
+word_set::word_set()
+{
+}
+
+/* Size the set to hold ids from a dawg of `word_count` words, and
+ * empty it, including its list of ignored words. */
+void word_set::set_word_count(int word_count)
+{
+  _seen.assign((word_count + 63) / 64, 0);
+  _ids.clear();
+}
+
+/* Never add the word `id` to the set. */
+void word_set::ignore(uint32_t id)
+{
+  _seen[id / 64] |= 1ULL << (id % 64);
+}
+
+/* Add every word in `other` to the set. */
+void word_set::add(word_set &other)
+{
+  for(size_t i = 0; i < other._ids.size(); i++)
+    add(other._ids[i]);
+}
+
+/* Remove the words `ids`, which must all be in the set, keeping the
+ * rest in the order they were added. */
+void word_set::remove(vector<uint32_t> &ids)
+{
+  if (ids.empty())
+    return;
+
+  for(size_t i = 0; i < ids.size(); i++)
+    _seen[ids[i] / 64] &= ~(1ULL << (ids[i] % 64));
+
+  size_t kept = 0;
+
+  for(size_t i = 0; i < _ids.size(); i++)
+    if (_seen[_ids[i] / 64] & (1ULL << (_ids[i] % 64)))
+      _ids[kept++] = _ids[i];
+
+  _ids.resize(kept);
+}
+
+/* Empty the set. Only the bits of words actually found are cleared,
+ * so this costs nothing for words that weren't, and leaves the
+ * ignored words in place. */
+void word_set::clear()
+{
+  for(size_t i = 0; i < _ids.size(); i++)
+    _seen[_ids[i] / 64] &= ~(1ULL << (_ids[i] % 64));
+
+  _ids.clear();
+}
+
+int word_set::size()
+{
+  return _ids.size();
+}
+
+vector<uint32_t> &word_set::ids()
+{
+  return _ids;
+}
+
+/* Size the masks for a dawg of `word_count` words, none of them in
+ * any lexicon. */
+void lexicon_masks::set_word_count(int word_count)
+{
+  _masks.assign(word_count, 0);
+}
+
+/* Put the words `ids` in lexicon number `lexicon`. */
+void lexicon_masks::add(int lexicon, vector<uint32_t> &ids)
+{
+  assert((lexicon >= 0) && (lexicon < MAX_LEXICONS));
+
+  for(size_t i = 0; i < ids.size(); i++)
+    _masks[ids[i]] |= 1U << lexicon;
+}
+
+/* Take the words `ids` out of lexicon number `lexicon`. */
+void lexicon_masks::remove(int lexicon, vector<uint32_t> &ids)
+{
+  assert((lexicon >= 0) && (lexicon < MAX_LEXICONS));
+
+  for(size_t i = 0; i < ids.size(); i++)
+    _masks[ids[i]] &= ~(1U << lexicon);
+}
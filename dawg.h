@@ -0,0 +1,312 @@
+// Copyright (c) Mike Schaeffer. All rights reserved.
+//
+// The use and distribution terms for this software are covered by the
+// Eclipse Public License 2.0 (https://opensource.org/licenses/EPL-2.0)
+// which can be found in the file LICENSE at the root of this distribution.
+// By using this software in any fashion, you are agreeing to be bound by
+// the terms of this license.
+//
+// You must not remove this notice, or any other, from this software.
+
+/*
+ * dawg.h - Minimized directed acyclic word graph
+ * by Michael Schaeffer
+ */
+
+#ifndef DAWG_H
+#define DAWG_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "common.h"
+#include "wordtree.h"
+
+/* A dawg is a read-only dictionary built by minimizing a wordtree:
+ * subtrees that accept the same set of suffixes are stored once, and
+ * each node's children live in a compact run of the shared edge
+ * array rather than in a fixed table of 26 pointers.
+ *
+ * Because nodes refer to each other by index, the node and edge
+ * arrays can be written to disk as a flat image and later mapped
+ * straight back into memory without any parsing.
+ *
+ * Each word also has an id: its position in alphabetical order among
+ * all the words in the dawg. Searches compute ids as they go, by
+ * adding up the offset stored with each edge they follow, so found
+ * words can be recorded without building any strings.
+ *
+ * Each node also notes the letters that every word below it still
+ * needs, and those it needs at least twice, so that a search can
+ * skip the parts of the graph that spell nothing out of the letters
+ * it has. */
+class word_set;
+class lexicon_masks;
+
+class dawg {
+private:
+  struct dawg_node;
+  typedef uint32_t dawg_edge;
+
+public:
+  dawg();
+  ~dawg();
+
+  void build(wordtree &wt);
+  void reorder(const vector<uint64_t> &visits);
+  void dump();
+
+  bool write_image(const char *filename);
+  bool map_image(const char *filename);
+  static bool is_image(const char *filename);
+
+  int node_count();
+  int edge_count();
+  int word_count();
+  int longest_word();
+
+  static const uint32_t NO_WORD = UINT32_MAX;
+
+  uint32_t word_id(const char *word);
+  bool word(uint32_t id, char *buf);
+  void word_ids(wordtree &words, vector<uint32_t> &ids);
+  void write_words(ostream &o, word_set &words);
+  void write_words(ostream &o, word_set &words, uint32_t lexicon,
+                   const lexicon_masks &lexicons);
+
+  /* Direct access to the graph for search kernels that track their
+   * own position rather than using an iterator. Nodes are numbered
+   * from the root, 0, and letters are given as 0-25. */
+  static const uint32_t NO_NODE = UINT32_MAX;
+
+  uint32_t root();
+  uint32_t child(uint32_t node, int letter);
+  bool is_word(uint32_t node);
+
+  uint32_t first_edge(uint32_t node);
+  uint32_t end_edge(uint32_t node);
+  int edge_letter(uint32_t edge);
+  uint32_t edge_target(uint32_t edge);
+  uint32_t edge_word_offset(uint32_t edge);
+  bool edge_fits(uint32_t edge, uint32_t letters, uint32_t doubled);
+
+  class iterator {
+  public:
+    iterator(dawg &d, char *prefix = NULL);
+
+    char *operator()();
+
+    bool letter_exists(char letter);
+    bool is_word();
+    uint32_t letters();
+
+    iterator letter(char letter);
+
+  private:
+    iterator(dawg *d, uint32_t node, char *prefix, char letter);
+    int find_edge(char letter);
+
+    char _prefix[PREFIX_BUF_SIZE];
+    dawg *_dawg;
+    uint32_t _current_node;
+  };
+
+private:
+  /* Edges are packed as (target node << 5) | (letter - 'a'). */
+  static const int EDGE_LETTER_BITS = 5;
+  static const dawg_edge EDGE_LETTER_MASK = (1 << EDGE_LETTER_BITS) - 1;
+
+  struct dawg_node {
+    uint32_t _first_edge;
+    uint8_t _edge_count;
+    uint8_t _is_word;
+    uint16_t _reserved;
+    uint32_t _needs;         // Letters every word below needs, as bits
+    uint32_t _needs_twice;   // ... and those it needs at least twice
+  };
+
+  /* The header at the front of a dictionary image. It is followed
+   * immediately by the node array, the edge array, and the edge word
+   * offset array. */
+  struct image_header {
+    char _magic[8];
+    uint32_t _version;
+    uint32_t _node_count;
+    uint32_t _edge_count;
+    uint32_t _word_count;
+    uint64_t _checksum;
+  };
+
+  /* The levels of the graph reorder() keeps breadth-first. */
+  static const int HOT_LEVELS = 3;
+
+  static const char IMAGE_MAGIC[8];
+  static const uint32_t IMAGE_VERSION = 3;
+
+  dawg(const dawg &);
+  dawg &operator=(const dawg &);
+
+  void release();
+  bool validate();
+  void place_subtree(uint32_t node, const vector<uint64_t> &visits,
+                     vector<uint32_t> &new_id, vector<uint32_t> &order);
+  void word_ids(wordtree::iterator i, vector<uint32_t> &ids);
+  int longest_word(uint32_t node, vector<int> &lengths);
+  static uint64_t checksum(const void *data, size_t length,
+                           uint64_t hash = 0xcbf29ce484222325ULL);
+
+  const dawg_node *_nodes;
+  const dawg_edge *_edges;
+  const uint32_t *_edge_word_offsets;  // Added to a node's first word id
+                                       // to get the first id past an edge
+  uint32_t _node_count;
+  uint32_t _edge_count;
+  uint32_t _word_count;
+
+  // Storage for a dawg built in memory
+  vector<dawg_node> _node_store;
+  vector<dawg_edge> _edge_store;
+  vector<uint32_t> _edge_word_offset_store;
+
+  // The mapping backing a dawg loaded from an image
+  void *_image;
+  size_t _image_size;
+};
+
+inline uint32_t dawg::root()
+{
+  return 0;
+}
+
+/* Return the node reached from `node` on `letter`, or NO_NODE. */
+inline uint32_t dawg::child(uint32_t node, int letter)
+{
+  const dawg_node &n = _nodes[node];
+  const dawg_edge *edge = _edges + n._first_edge;
+
+  for(int i = 0; i < n._edge_count; i++)
+    if ((edge[i] & EDGE_LETTER_MASK) == (dawg_edge)letter)
+      return edge[i] >> EDGE_LETTER_BITS;
+
+  return NO_NODE;
+}
+
+inline bool dawg::is_word(uint32_t node)
+{
+  return _nodes[node]._is_word;
+}
+
+/* The edges leaving `node` are numbered first_edge(node) up to, but
+ * not including, end_edge(node), in alphabetical order. */
+inline uint32_t dawg::first_edge(uint32_t node)
+{
+  return _nodes[node]._first_edge;
+}
+
+inline uint32_t dawg::end_edge(uint32_t node)
+{
+  return _nodes[node]._first_edge + _nodes[node]._edge_count;
+}
+
+inline int dawg::edge_letter(uint32_t edge)
+{
+  return _edges[edge] & EDGE_LETTER_MASK;
+}
+
+inline uint32_t dawg::edge_target(uint32_t edge)
+{
+  return _edges[edge] >> EDGE_LETTER_BITS;
+}
+
+inline uint32_t dawg::edge_word_offset(uint32_t edge)
+{
+  return _edge_word_offsets[edge];
+}
+
+/* Return false if no word continuing along `edge` can be spelled from
+ * a set of letters that has only `letters`, and twice over only
+ * `doubled`, both as bits. */
+inline bool dawg::edge_fits(uint32_t edge, uint32_t letters, uint32_t doubled)
+{
+  const dawg_node &n = _nodes[_edges[edge] >> EDGE_LETTER_BITS];
+  uint32_t bit = 1 << (_edges[edge] & EDGE_LETTER_MASK);
+
+  return !(((n._needs | bit) & ~letters)
+           | ((n._needs_twice | (n._needs & bit)) & ~doubled));
+}
+
+/* The set of words found by a search, as dawg word ids. Adding a word
+ * is a single bit test, and the ids are only turned back into strings
+ * when the set is written out. A set can be given a list of words to
+ * ignore, which it then refuses to add.
+ */
+class word_set {
+public:
+  word_set();
+
+  void set_word_count(int word_count);
+  void ignore(uint32_t id);
+
+  bool add(uint32_t id);
+  void add(word_set &other);
+  bool contains(uint32_t id);
+  void remove(vector<uint32_t> &ids);
+  void clear();
+
+  int size();
+  vector<uint32_t> &ids();
+
+private:
+  vector<uint64_t> _seen;
+  vector<uint32_t> _ids;
+};
+
+/* Add the word `id` to the set, returning false if it was already
+ * present or is being ignored. */
+inline bool word_set::add(uint32_t id)
+{
+  uint64_t bit = 1ULL << (id % 64);
+
+  if (_seen[id / 64] & bit)
+    return false;
+
+  _seen[id / 64] |= bit;
+  _ids.push_back(id);
+
+  return true;
+}
+
+/* Return true if the word `id` is in the set, or is being ignored. */
+inline bool word_set::contains(uint32_t id)
+{
+  return (_seen[id / 64] & (1ULL << (id % 64))) != 0;
+}
+
+/* The lexicons each word of a dawg belongs to, for a dawg built from
+ * the words of up to 32 word lists together. Each word has a mask
+ * with a bit for each lexicon, so one search of the dawg finds the
+ * words of every lexicon at once, and they're told apart by their
+ * masks when they're reported. Ignoring a word in a lexicon only
+ * clears its bit, so the dawg itself is never changed.
+ */
+class lexicon_masks {
+public:
+  static const int MAX_LEXICONS = 32;
+
+  void set_word_count(int word_count);
+
+  void add(int lexicon, vector<uint32_t> &ids);
+  void remove(int lexicon, vector<uint32_t> &ids);
+
+  uint32_t mask(uint32_t id) const;
+
+private:
+  vector<uint32_t> _masks;
+};
+
+inline uint32_t lexicon_masks::mask(uint32_t id) const
+{
+  return _masks[id];
+}
+
+#endif
@@ -0,0 +1,1161 @@
+// Copyright (c) Mike Schaeffer. All rights reserved.
+//
+// The use and distribution terms for this software are covered by the
+// Eclipse Public License 2.0 (https://opensource.org/licenses/EPL-2.0)
+// which can be found in the file LICENSE at the root of this distribution.
+// By using this software in any fashion, you are agreeing to be bound by
+// the terms of this license.
+//
+// You must not remove this notice, or any other, from this software.
+
+/*
+ * optimizer.cc - Searching for high scoring boards
+ * by Michael Schaeffer
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <mutex>
+
+#include "common.h"
+#include "dawg.h"
+#include "boggle_board.h"
+#include "score.h"
+#include "thread_pool.h"
+#include "optimizer.h"
+
+optimizer_dictionary::optimizer_dictionary(dawg &dict, score_table &scores)
+  : _dict(dict), _scores(scores)
+{
+  _ignored.assign(dict.word_count(), 0);
+
+  // Letters no word starts with, including the one past 'z', have no
+  // edge.
+  for(int letter = 0; letter < 27; letter++)
+    _root_edges[letter] = NO_EDGE;
+
+  for(uint32_t edge = dict.first_edge(dict.root());
+      edge < dict.end_edge(dict.root());
+      edge++)
+    _root_edges[dict.edge_letter(edge)] = edge;
+}
+
+/* Never score the word `id`. */
+void optimizer_dictionary::ignore(uint32_t id)
+{
+  _ignored[id] = 1;
+}
+
+const int board_scorer::NO_LETTER;
+const int board_scorer::NO_PREFIX;
+
+board_scorer::board_scorer(optimizer_dictionary &od, int xsize, int ysize)
+  : _od(od)
+{
+  _xsize = xsize;
+  _ysize = ysize;
+  _cell_count = xsize * ysize;
+
+  _letters.assign(_cell_count, NO_LETTER);
+  _neighbors.assign(_cell_count * 8, 0);
+  _neighbor_count.assign(_cell_count, 0);
+  _neighbor_letters.assign(_cell_count, 0);
+  _visited.assign((_cell_count + 63) / 64, 0);
+
+  // Cells are numbered row by row, as in a board file.
+  for(int cell = 0; cell < _cell_count; cell++) {
+    int x = cell / ysize, y = cell % ysize;
+
+    for(int dx = -1; dx <= 1; dx++)
+      for(int dy = -1; dy <= 1; dy++)
+        if (((dx != 0) || (dy != 0))
+            && (x + dx >= 0) && (x + dx < xsize)
+            && (y + dy >= 0) && (y + dy < ysize))
+          _neighbors[cell * 8 + _neighbor_count[cell]++] = cell + dx * ysize + dy;
+  }
+
+  _cell_prefixes.assign(_cell_count, NO_PREFIX);
+  _free_prefixes = NO_PREFIX;
+
+  _path_counts.assign(od._dict.word_count(), 0);
+  _tried.assign(od._dict.word_count(), 0);
+  _score = 0;
+}
+
+int board_scorer::xsize()
+{
+  return _xsize;
+}
+
+int board_scorer::ysize()
+{
+  return _ysize;
+}
+
+int board_scorer::cell_count()
+{
+  return _cell_count;
+}
+
+/* Take the letters of `board`, which must be the scorer's size, and
+ * find every path on it from scratch. */
+void board_scorer::set_board(boggle_board &board)
+{
+  assert((board.xsize() == _xsize) && (board.ysize() == _ysize));
+
+  for(int cell = 0; cell < _cell_count; cell++) {
+    char ch = board.ref(1 + cell / _ysize, 1 + cell % _ysize);
+
+    _letters[cell] = ((ch >= 'a') && (ch <= 'z')) ? ch - 'a' : NO_LETTER;
+  }
+
+  for(int cell = 0; cell < _cell_count; cell++)
+    set_neighbor_letters(cell);
+
+  _prefixes.clear();
+  _cell_prefixes.assign(_cell_count, NO_PREFIX);
+  _free_prefixes = NO_PREFIX;
+
+  _path_counts.assign(_path_counts.size(), 0);
+  _score = 0;
+
+  dawg &dict = _od._dict;
+
+  for(int start = 0; start < _cell_count; start++) {
+    uint32_t edge = _od._root_edges[_letters[start]];
+
+    if (edge == optimizer_dictionary::NO_EDGE)
+      continue;
+
+    int p = add_prefix(start, dict.edge_target(edge),
+                       dict.edge_word_offset(edge), NO_PREFIX);
+
+    mark(start, true);
+    grow(p);
+    mark(start, false);
+  }
+}
+
+/* Copy the scorer's letters into `board`. */
+void board_scorer::get_board(boggle_board &board)
+{
+  if ((board.xsize() != _xsize) || (board.ysize() != _ysize))
+    board.set_size(_xsize, _ysize);
+
+  for(int cell = 0; cell < _cell_count; cell++)
+    board.set(1 + cell / _ysize, 1 + cell % _ysize, letter(cell));
+}
+
+char board_scorer::letter(int cell)
+{
+  return (_letters[cell] < 26) ? 'a' + _letters[cell] : '*';
+}
+
+/* Change the letter of `cell`, updating the score by recounting only
+ * the paths through it. The words this adds to or removes from the
+ * board are then given by words_added() and words_removed(). */
+void board_scorer::set_letter(int cell, char letter)
+{
+  _added.clear();
+  _removed.clear();
+
+  count_out(cell, true);
+  set_cell(cell, ((letter >= 'a') && (letter <= 'z')) ? letter - 'a' : NO_LETTER);
+  count_in(cell);
+
+  // A word counted out and back in again hasn't changed.
+  size_t kept = 0;
+
+  for(size_t i = 0; i < _removed.size(); i++)
+    if (_path_counts[_removed[i]] > 0)
+      _tried[_removed[i]] = 1;
+    else
+      _removed[kept++] = _removed[i];
+
+  _removed.resize(kept);
+  kept = 0;
+
+  for(size_t i = 0; i < _added.size(); i++)
+    if (_tried[_added[i]])
+      _tried[_added[i]] = 0;
+    else
+      _added[kept++] = _added[i];
+
+  _added.resize(kept);
+}
+
+int board_scorer::score()
+{
+  return _score;
+}
+
+/* Fill `scores` with what the board would score with each letter, 'a'
+ * through 'z', in `cell`, leaving the board as it was. The paths
+ * through the cell are counted out, without being thrown away, and
+ * then every path that could go through the cell with some letter is
+ * followed. A word only adds points for a letter if it had no path
+ * left once the cell's own paths were counted out, and only once for
+ * each letter it can be spelled with.
+ */
+void board_scorer::letter_scores(int cell, int *scores)
+{
+  dawg &dict = _od._dict;
+  int score = _score;
+
+  count_out(cell, false);
+
+  int without = _score;
+
+  for(int i = 0; i < 26; i++)
+    _gains[i] = 0;
+
+  // Paths that start on the cell...
+  mark(cell, true);
+
+  for(uint32_t edge = dict.first_edge(dict.root());
+      edge < dict.end_edge(dict.root());
+      edge++) {
+    _trial_letter = dict.edge_letter(edge);
+    try_letters(cell, dict.edge_target(edge), dict.edge_word_offset(edge), 1);
+  }
+
+  mark(cell, false);
+
+  // ... and those that step onto it from a prefix ending next to it,
+  // other than the prefixes that have already been through it.
+  for(int i = 0; i < _neighbor_count[cell]; i++)
+    for(int p = _cell_prefixes[_neighbors[cell * 8 + i]];
+        p != NO_PREFIX;
+        p = _prefixes[p]._next_at_cell) {
+      if (_prefixes[p]._depth == MAX_WORD_SIZE - 1)
+        continue;
+
+      mark_path(p, true);
+
+      if (!is_visited(cell)) {
+        uint32_t node = _prefixes[p]._node;
+        int depth = _prefixes[p]._depth;
+
+        mark(cell, true);
+
+        for(uint32_t edge = dict.first_edge(node); edge < dict.end_edge(node); edge++) {
+          _trial_letter = dict.edge_letter(edge);
+          try_letters(cell, dict.edge_target(edge),
+                      _prefixes[p]._word_id + dict.edge_word_offset(edge),
+                      depth + 1);
+        }
+
+        mark(cell, false);
+      }
+
+      mark_path(p, false);
+    }
+
+  for(size_t i = 0; i < _tried_ids.size(); i++)
+    _tried[_tried_ids[i]] = 0;
+
+  _tried_ids.clear();
+
+  // Put back the paths that were counted out.
+  for(size_t i = 0; i < _journal.size(); i++)
+    _path_counts[_journal[i]]++;
+
+  _removed.clear();
+  _score = score;
+
+  for(int i = 0; i < 26; i++)
+    scores[i] = without + _gains[i];
+
+  assert((_letters[cell] >= 26) || (scores[_letters[cell]] == score));
+}
+
+/* Return TRUE if the word `id` is on the board. Ignored words are
+ * counted like any other, but never score. */
+bool board_scorer::has_word(uint32_t id)
+{
+  return _path_counts[id] > 0;
+}
+
+/* The words the last set_letter() put on the board, and those it took
+ * off, leaving out ignored words. */
+vector<uint32_t> &board_scorer::words_added()
+{
+  return _added;
+}
+
+vector<uint32_t> &board_scorer::words_removed()
+{
+  return _removed;
+}
+
+/* Put the letter number `letter` in `cell`, without rescoring. */
+void board_scorer::set_cell(int cell, int letter)
+{
+  _letters[cell] = letter;
+
+  for(int i = 0; i < _neighbor_count[cell]; i++)
+    set_neighbor_letters(_neighbors[cell * 8 + i]);
+}
+
+/* Recompute the set of letters next to `cell`. */
+void board_scorer::set_neighbor_letters(int cell)
+{
+  uint32_t letters = 0;
+
+  for(int i = 0; i < _neighbor_count[cell]; i++)
+    letters |= 1 << _letters[_neighbors[cell * 8 + i]];
+
+  _neighbor_letters[cell] = letters;
+}
+
+/* Add a prefix that extends `parent` onto `cell`, reaching `node`, and
+ * count the word it spells, if any. Returns the new prefix. */
+int board_scorer::add_prefix(int cell, uint32_t node, uint32_t word_id, int parent)
+{
+  int p = _free_prefixes;
+
+  if (p != NO_PREFIX)
+    _free_prefixes = _prefixes[p]._next_sibling;
+  else {
+    p = _prefixes.size();
+    _prefixes.push_back(prefix());
+  }
+
+  prefix &n = _prefixes[p];
+
+  n._cell = cell;
+  n._node = node;
+  n._word_id = word_id;
+  n._depth = (parent == NO_PREFIX) ? 1 : _prefixes[parent]._depth + 1;
+  n._parent = parent;
+  n._first_child = NO_PREFIX;
+  n._prev_sibling = NO_PREFIX;
+  n._next_sibling = NO_PREFIX;
+
+  if (parent != NO_PREFIX) {
+    n._next_sibling = _prefixes[parent]._first_child;
+
+    if (n._next_sibling != NO_PREFIX)
+      _prefixes[n._next_sibling]._prev_sibling = p;
+
+    _prefixes[parent]._first_child = p;
+  }
+
+  n._prev_at_cell = NO_PREFIX;
+  n._next_at_cell = _cell_prefixes[cell];
+
+  if (n._next_at_cell != NO_PREFIX)
+    _prefixes[n._next_at_cell]._prev_at_cell = p;
+
+  _cell_prefixes[cell] = p;
+
+  if (_od._dict.is_word(node))
+    tally(word_id, n._depth, 1);
+
+  return p;
+}
+
+/* Unlink the prefix `p` from its cell's list and put it on the free
+ * list. Its parent and children are left to the caller. */
+void board_scorer::free_prefix(int p)
+{
+  prefix &n = _prefixes[p];
+
+  if (n._prev_at_cell != NO_PREFIX)
+    _prefixes[n._prev_at_cell]._next_at_cell = n._next_at_cell;
+  else
+    _cell_prefixes[n._cell] = n._next_at_cell;
+
+  if (n._next_at_cell != NO_PREFIX)
+    _prefixes[n._next_at_cell]._prev_at_cell = n._prev_at_cell;
+
+  n._next_sibling = _free_prefixes;
+  _free_prefixes = p;
+}
+
+/* Mark or unmark every cell on the path of prefix `p`. */
+void board_scorer::mark_path(int p, bool on)
+{
+  for(; p != NO_PREFIX; p = _prefixes[p]._parent)
+    mark(_prefixes[p]._cell, on);
+}
+
+inline bool board_scorer::is_visited(int cell)
+{
+  return _visited[cell / 64] & (1ULL << (cell % 64));
+}
+
+inline void board_scorer::mark(int cell, bool on)
+{
+  if (on)
+    _visited[cell / 64] |= 1ULL << (cell % 64);
+  else
+    _visited[cell / 64] &= ~(1ULL << (cell % 64));
+}
+
+/* Add every prefix that extends `p`, whose cells must be marked. */
+void board_scorer::grow(int p)
+{
+  dawg &dict = _od._dict;
+  int cell = _prefixes[p]._cell;
+  uint32_t node = _prefixes[p]._node;
+  uint32_t word_id = _prefixes[p]._word_id;
+
+  if (_prefixes[p]._depth == MAX_WORD_SIZE - 1)
+    return;
+
+  int *neighbors = &_neighbors[cell * 8];
+  uint32_t end_edge = dict.end_edge(node);
+
+  // Step along each edge whose letter is next to this cell.
+  for(uint32_t edge = dict.first_edge(node); edge < end_edge; edge++) {
+    int letter = dict.edge_letter(edge);
+
+    if (!(_neighbor_letters[cell] & (1 << letter)))
+      continue;
+
+    for(int i = 0; i < _neighbor_count[cell]; i++) {
+      int next = neighbors[i];
+
+      if ((_letters[next] != letter) || is_visited(next))
+        continue;
+
+      int child = add_prefix(next, dict.edge_target(edge),
+                             word_id + dict.edge_word_offset(edge), p);
+
+      mark(next, true);
+      grow(child);
+      mark(next, false);
+    }
+  }
+}
+
+/* Count out every path through `cell`: the prefixes ending on it, and
+ * all that extend them. If `remove` is set, they're also thrown away;
+ * otherwise, the words counted out are kept in _journal so that they
+ * can be put back. */
+void board_scorer::count_out(int cell, bool remove)
+{
+  dawg &dict = _od._dict;
+  int p = _cell_prefixes[cell];
+
+  _journal.clear();
+
+  while (p != NO_PREFIX) {
+    int next = _prefixes[p]._next_at_cell;
+
+    // Take the whole tree off its parent at once.
+    if (remove && (_prefixes[p]._parent != NO_PREFIX)) {
+      prefix &n = _prefixes[p];
+
+      if (n._prev_sibling != NO_PREFIX)
+        _prefixes[n._prev_sibling]._next_sibling = n._next_sibling;
+      else
+        _prefixes[n._parent]._first_child = n._next_sibling;
+
+      if (n._next_sibling != NO_PREFIX)
+        _prefixes[n._next_sibling]._prev_sibling = n._prev_sibling;
+    }
+
+    _stack.push_back(p);
+
+    while (!_stack.empty()) {
+      int q = _stack.back();
+
+      _stack.pop_back();
+
+      if (dict.is_word(_prefixes[q]._node))
+        tally(_prefixes[q]._word_id, _prefixes[q]._depth, -1);
+
+      for(int child = _prefixes[q]._first_child;
+          child != NO_PREFIX;
+          child = _prefixes[child]._next_sibling)
+        _stack.push_back(child);
+
+      if (remove)
+        free_prefix(q);
+    }
+
+    p = next;
+  }
+}
+
+/* Count in every path through `cell`, which must have none: those
+ * starting on it, and those stepping onto it from a prefix next to
+ * it. */
+void board_scorer::count_in(int cell)
+{
+  dawg &dict = _od._dict;
+  int letter = _letters[cell];
+
+  // Take the prefixes next to the cell before adding any, since the
+  // new ones can end next to it too.
+  _next_to.clear();
+
+  for(int i = 0; i < _neighbor_count[cell]; i++)
+    for(int p = _cell_prefixes[_neighbors[cell * 8 + i]];
+        p != NO_PREFIX;
+        p = _prefixes[p]._next_at_cell)
+      _next_to.push_back(p);
+
+  // A letter that starts no word can still continue them.
+  uint32_t edge = _od._root_edges[letter];
+
+  if (edge != optimizer_dictionary::NO_EDGE) {
+    int start = add_prefix(cell, dict.edge_target(edge),
+                           dict.edge_word_offset(edge), NO_PREFIX);
+
+    mark(cell, true);
+    grow(start);
+    mark(cell, false);
+  }
+
+  for(size_t i = 0; i < _next_to.size(); i++) {
+    int p = _next_to[i];
+    uint32_t node = _prefixes[p]._node;
+
+    if (_prefixes[p]._depth == MAX_WORD_SIZE - 1)
+      continue;
+
+    for(edge = dict.first_edge(node); edge < dict.end_edge(node); edge++) {
+      if (dict.edge_letter(edge) < letter)
+        continue;
+
+      if (dict.edge_letter(edge) == letter) {
+        int child = add_prefix(cell, dict.edge_target(edge),
+                               _prefixes[p]._word_id + dict.edge_word_offset(edge),
+                               p);
+
+        mark_path(child, true);
+        grow(child);
+        mark_path(child, false);
+      }
+
+      break;
+    }
+  }
+}
+
+/* Follow every path from `cell`, reached at `node`, for
+ * letter_scores(). The path's cells must be marked. */
+void board_scorer::try_letters(int cell, uint32_t node, uint32_t word_id, int depth)
+{
+  dawg &dict = _od._dict;
+
+  if (dict.is_word(node))
+    tally(word_id, depth, 0);
+
+  if (depth == MAX_WORD_SIZE - 1)
+    return;
+
+  int *neighbors = &_neighbors[cell * 8];
+  uint32_t end_edge = dict.end_edge(node);
+
+  for(uint32_t edge = dict.first_edge(node); edge < end_edge; edge++) {
+    int letter = dict.edge_letter(edge);
+
+    if (!(_neighbor_letters[cell] & (1 << letter)))
+      continue;
+
+    for(int i = 0; i < _neighbor_count[cell]; i++) {
+      int next = neighbors[i];
+
+      if ((_letters[next] != letter) || is_visited(next))
+        continue;
+
+      mark(next, true);
+      try_letters(next, dict.edge_target(edge),
+                  word_id + dict.edge_word_offset(edge), depth + 1);
+      mark(next, false);
+    }
+  }
+}
+
+/* Count a path spelling the word `id`, of `length` letters, in (if
+ * `sign` is 1) or out (if it's -1). The word's points count toward
+ * the score while it has at least one path. With a `sign` of 0, the
+ * path is one letter_scores() is trying, with the changing cell
+ * holding _trial_letter. */
+void board_scorer::tally(uint32_t id, int length, int sign)
+{
+  if (sign > 0) {
+    if ((_path_counts[id]++ == 0) && !_od._ignored[id]) {
+      _score += _od._scores.score(length);
+      _added.push_back(id);
+    }
+  } else if (sign < 0) {
+    assert(_path_counts[id] > 0);
+
+    _journal.push_back(id);
+
+    if ((--_path_counts[id] == 0) && !_od._ignored[id]) {
+      _score -= _od._scores.score(length);
+      _removed.push_back(id);
+    }
+  } else {
+    uint32_t bit = 1 << _trial_letter;
+
+    if ((_path_counts[id] > 0) || _od._ignored[id] || (_tried[id] & bit))
+      return;
+
+    if (_tried[id] == 0)
+      _tried_ids.push_back(id);
+
+    _tried[id] |= bit;
+    _gains[_trial_letter] += _od._scores.score(length);
+  }
+}
+
+/* The temperatures the annealing starts and ends at, in points. */
+static const double START_TEMPERATURE = 50.0;
+static const double END_TEMPERATURE = 0.5;
+
+/* Return a random number in [0, 1). */
+static double random_fraction(counter_random &random)
+{
+  return (random.next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Run one chain of the annealing, starting from `board`, and leave
+ * the best board it finds in `board`. Returns that board's score.
+ *
+ * Each step picks a cell, scores the board with every letter in it,
+ * and then draws the cell's new letter with a weight of
+ * exp(score / temperature), so better letters are always likelier,
+ * and more so as the search cools.
+ */
+static int anneal(optimizer_dictionary &od,
+                  boggle_board &board,
+                  long steps,
+                  counter_random &random)
+{
+  board_scorer scorer(od, board.xsize(), board.ysize());
+  int cells = scorer.cell_count();
+  int scores[26];
+  double weights[26];
+
+  scorer.set_board(board);
+
+  int best_score = scorer.score();
+  double cooling = pow(END_TEMPERATURE / START_TEMPERATURE, 1.0 / steps);
+  double temperature = START_TEMPERATURE;
+
+  for(long step = 0; step < steps; step++, temperature *= cooling) {
+    int cell = random.limited(cells);
+    int best_letter = 0;
+
+    scorer.letter_scores(cell, scores);
+
+    for(int i = 1; i < 26; i++)
+      if (scores[i] > scores[best_letter])
+        best_letter = i;
+
+    if (scores[best_letter] > best_score) {
+      best_score = scores[best_letter];
+      scorer.get_board(board);
+      board.set(1 + cell / board.ysize(), 1 + cell % board.ysize(),
+                'a' + best_letter);
+    }
+
+    double total = 0.0;
+
+    for(int i = 0; i < 26; i++) {
+      weights[i] = exp((scores[i] - scores[best_letter]) / temperature);
+      total += weights[i];
+    }
+
+    double pick = random_fraction(random) * total;
+    int letter = 0;
+
+    while ((letter < 25) && (pick >= weights[letter]))
+      pick -= weights[letter++];
+
+    if ('a' + letter != scorer.letter(cell))
+      scorer.set_letter(cell, 'a' + letter);
+  }
+
+  return best_score;
+}
+
+int optimize_board(optimizer_dictionary &od,
+                   int xsize, int ysize,
+                   int chains, long steps, uint64_t seed,
+                   thread_pool &pool,
+                   boggle_board &best)
+{
+  vector<int> scores(chains);
+  boggle_board *boards = new boggle_board[chains];
+
+  pool.run(chains, [&](int worker, int chain) {
+      counter_random random(seed, chain);
+
+      boards[chain].set_size(xsize, ysize);
+      boards[chain].shuffle(random);
+
+      scores[chain] = anneal(od, boards[chain], steps, random);
+    });
+
+  int best_chain = 0;
+
+  for(int chain = 1; chain < chains; chain++)
+    if (scores[chain] > scores[best_chain])
+      best_chain = chain;
+
+  best.set_size(xsize, ysize);
+
+  for(int x = 1; x <= xsize; x++)
+    for(int y = 1; y <= ysize; y++)
+      best.set(x, y, boards[best_chain].ref(x, y));
+
+  delete [] boards;
+
+  return scores[best_chain];
+}
+
+class_bounder::class_bounder(optimizer_dictionary &od, int xsize, int ysize)
+  : _od(od)
+{
+  assert(xsize * ysize <= 32);
+
+  _ysize = ysize;
+  _cell_count = xsize * ysize;
+
+  // Cells are numbered row by row, as for a board_scorer.
+  for(int cell = 0; cell < _cell_count; cell++) {
+    int x = cell / ysize, y = cell % ysize;
+
+    _neighbors[cell] = 0;
+
+    for(int dx = -1; dx <= 1; dx++)
+      for(int dy = -1; dy <= 1; dy++)
+        if (((dx != 0) || (dy != 0))
+            && (x + dx >= 0) && (x + dx < xsize)
+            && (y + dy >= 0) && (y + dy < ysize))
+          _neighbors[cell] |= 1U << (cell + dx * ysize + dy);
+  }
+
+  _found.set_word_count(od._dict.word_count());
+
+  for(uint32_t id = 0; id < od._ignored.size(); id++)
+    if (od._ignored[id])
+      _found.ignore(id);
+
+  _board.set_size(xsize, ysize);
+}
+
+/* Return an upper bound on the score of every board in the class
+ * whose cells may hold the letters in `letters`, one set of bits for
+ * each cell. A cell with no letters makes the class empty. Once the
+ * bound is known to be no more than `floor`, it isn't narrowed any
+ * further. */
+int class_bounder::bound(const uint32_t *letters, int floor)
+{
+  dawg &dict = _od._dict;
+  uint32_t root = dict.root();
+
+  int most_letters = 0;
+
+  _have = 0;
+  _doubled = 0;
+
+  for(int letter = 0; letter < 26; letter++)
+    _cells_with[letter] = 0;
+
+  for(int cell = 0; cell < _cell_count; cell++) {
+    if (letters[cell] == 0)
+      return 0;
+
+    if (__builtin_popcount(letters[cell]) > most_letters)
+      most_letters = __builtin_popcount(letters[cell]);
+
+    _doubled |= _have & letters[cell];
+    _have |= letters[cell];
+
+    for(uint32_t bits = letters[cell]; bits; bits &= bits - 1)
+      _cells_with[__builtin_ctz(bits)] |= 1U << cell;
+  }
+
+  _found.clear();
+  _sum = 0;
+
+  int best[32] = { 0 }, values[32];
+
+  for(uint32_t edge = dict.first_edge(root); edge < dict.end_edge(root); edge++) {
+    uint32_t reach = _cells_with[dict.edge_letter(edge)];
+
+    if (!reach || !dict.edge_fits(edge, _have, _doubled))
+      continue;
+
+    uint32_t id = dict.edge_word_offset(edge);
+    int points = word_points(edge, id, 1);
+
+    visit(dict.edge_target(edge), id, 1, reach, values);
+
+    for(uint32_t bits = reach; bits; bits &= bits - 1) {
+      int cell = __builtin_ctz(bits);
+
+      if (values[cell] + points > best[cell])
+        best[cell] = values[cell] + points;
+    }
+  }
+
+  int max = 0;
+
+  for(int cell = 0; cell < _cell_count; cell++)
+    max += best[cell];
+
+  int bound = (_sum < max) ? _sum : max;
+
+  // Only in small classes are there few enough paths that never go
+  // through a cell twice to follow them all.
+  if ((bound <= floor) || (most_letters > MARKED_LETTERS))
+    return bound;
+
+  _letters = letters;
+  _found.clear();
+  _sum = 0;
+  max = 0;
+
+  for(int cell = 0; cell < _cell_count; cell++)
+    max += max_from(cell, root, 0, 0, 0);
+
+  if (_sum < bound)
+    bound = _sum;
+
+  return (max < bound) ? max : bound;
+}
+
+/* Return the points for the word, if any, that following `edge`
+ * spells, with an id of `word_id` and `length` letters, adding them
+ * to the sum bound the first time it's spelled. */
+int class_bounder::word_points(uint32_t edge, uint32_t word_id, int length)
+{
+  if (!_od._dict.is_word(_od._dict.edge_target(edge)) || _od._ignored[word_id])
+    return 0;
+
+  int points = _od._scores.score(length);
+
+  if (_found.add(word_id))
+    _sum += points;
+
+  return points;
+}
+
+/* Return the most points the paths continuing from `cell`, after a
+ * path of `depth` cells in `visited` leading to `node`, can score on
+ * a board in the class, taking the best letter for each cell they
+ * reach. No path goes through a cell twice. Each word spelled along
+ * the way is added to the sum bound, if it hasn't been already. */
+int class_bounder::max_from(int cell,
+                            uint32_t node,
+                            uint32_t word_id,
+                            uint32_t visited,
+                            int depth)
+{
+  dawg &dict = _od._dict;
+  uint32_t choices = _letters[cell];
+  int best = 0;
+
+  visited |= 1U << cell;
+
+  for(uint32_t edge = dict.first_edge(node); edge < dict.end_edge(node); edge++) {
+    if (!(choices & (1U << dict.edge_letter(edge)))
+        || !dict.edge_fits(edge, _have, _doubled))
+      continue;
+
+    uint32_t child = dict.edge_target(edge);
+    uint32_t id = word_id + dict.edge_word_offset(edge);
+    int points = word_points(edge, id, depth + 1);
+
+    if (depth + 1 < MAX_WORD_SIZE - 1)
+      for(uint32_t around = _neighbors[cell] & ~visited; around; around &= around - 1)
+        points += max_from(__builtin_ctz(around), child, id, visited, depth + 1);
+
+    if (points > best)
+      best = points;
+  }
+
+  return best;
+}
+
+/* Follow the paths that spell the `depth` letters leading to `node`
+ * and end at one of the cells in `reach`. For each of those cells,
+ * set `values[cell]` to the most points the paths continuing from it
+ * can score, taking the best letter for each cell they go through. */
+void class_bounder::visit(uint32_t node,
+                          uint32_t word_id,
+                          int depth,
+                          uint32_t reach,
+                          int *values)
+{
+  dawg &dict = _od._dict;
+  uint32_t next = 0;
+  int best[32], child_values[32];
+
+  for(uint32_t bits = reach; bits; bits &= bits - 1) {
+    int cell = __builtin_ctz(bits);
+
+    next |= _neighbors[cell];
+    values[cell] = 0;
+  }
+
+  if (depth >= MAX_WORD_SIZE - 1)
+    return;
+
+  for(uint32_t bits = next; bits; bits &= bits - 1)
+    best[__builtin_ctz(bits)] = 0;
+
+  for(uint32_t edge = dict.first_edge(node); edge < dict.end_edge(node); edge++) {
+    uint32_t child_reach = next & _cells_with[dict.edge_letter(edge)];
+
+    if (!child_reach || !dict.edge_fits(edge, _have, _doubled))
+      continue;
+
+    uint32_t id = word_id + dict.edge_word_offset(edge);
+    int points = word_points(edge, id, depth + 1);
+
+    visit(dict.edge_target(edge), id, depth + 1, child_reach, child_values);
+
+    for(uint32_t bits = child_reach; bits; bits &= bits - 1) {
+      int cell = __builtin_ctz(bits);
+
+      if (child_values[cell] + points > best[cell])
+        best[cell] = child_values[cell] + points;
+    }
+  }
+
+  for(uint32_t bits = reach; bits; bits &= bits - 1) {
+    int cell = __builtin_ctz(bits);
+
+    for(uint32_t around = _neighbors[cell] & next; around; around &= around - 1)
+      values[cell] += best[__builtin_ctz(around)];
+  }
+}
+
+/* Return the score of the one board in a class whose cells each have
+ * a single letter. */
+int class_bounder::score(const uint32_t *letters)
+{
+  for(int cell = 0; cell < _cell_count; cell++)
+    _board.set(1 + cell / _ysize, 1 + cell % _ysize,
+               'a' + __builtin_ctz(letters[cell]));
+
+  _found.clear();
+
+  return _board.score_words(_od._dict, _found, _od._scores);
+}
+
+/* The order a cell's letters are split in two, so the vowels and the
+ * commonest consonants are told apart first. */
+static const char split_order[] = "aeiousyrtlnchdmpbgfkwvjxzq";
+
+/* Return the cell of a class to split next: the one with the most
+ * letters, and of those, the one with the most neighbors. Returns -1
+ * if every cell has only one letter left. */
+static int split_cell(const vector<uint32_t> &letters, int xsize, int ysize)
+{
+  int best_cell = -1, best_letters = 1, best_neighbors = 0;
+
+  for(int cell = 0; cell < (int)letters.size(); cell++) {
+    int x = cell / ysize, y = cell % ysize;
+    int count = __builtin_popcount(letters[cell]);
+    int neighbors = ((x > 0) + (x < xsize - 1) + 1)
+      * ((y > 0) + (y < ysize - 1) + 1) - 1;
+
+    if (count < 2)
+      continue;
+
+    if ((count > best_letters)
+        || ((count == best_letters) && (neighbors > best_neighbors))) {
+      best_cell = cell;
+      best_letters = count;
+      best_neighbors = neighbors;
+    }
+  }
+
+  return best_cell;
+}
+
+/* Split the set of letters `letters` in two, in split_order. A single
+ * letter is split into itself and nothing. */
+static void split_letters(uint32_t letters, uint32_t &first, uint32_t &second)
+{
+  int half = (__builtin_popcount(letters) + 1) / 2;
+
+  first = 0;
+
+  for(const char *ch = split_order; half > 0; ch++)
+    if (letters & (1U << (*ch - 'a'))) {
+      first |= 1U << (*ch - 'a');
+      half--;
+    }
+
+  second = letters & ~first;
+}
+
+/* What the threads of a search_board_classes share. */
+struct class_search {
+  int xsize, ysize;
+  atomic<int> best_score;
+  vector<uint32_t> best_letters;   // Guarded by the lock
+  mutex lock;
+};
+
+/* Search every board in the class `letters` for one scoring more than
+ * the best found so far. A class is bounded, and dropped if its bound
+ * is no better than the best, or else split in two by one of its
+ * cells' letters and each half searched in turn, until it's a single
+ * board, which is scored. */
+static void search_class(class_search &search,
+                         class_bounder &bounder,
+                         vector<uint32_t> &letters,
+                         long &classes_bounded)
+{
+  int bound = bounder.bound(letters.data(), search.best_score);
+
+  classes_bounded++;
+
+  if (bound <= search.best_score)
+    return;
+
+  int cell = split_cell(letters, search.xsize, search.ysize);
+
+  if (cell < 0) {
+    int score = bounder.score(letters.data());
+    unique_lock<mutex> guard(search.lock);
+
+    if (score > search.best_score) {
+      search.best_score = score;
+      search.best_letters = letters;
+    }
+
+    return;
+  }
+
+  uint32_t all = letters[cell], first, second;
+
+  split_letters(all, first, second);
+
+  letters[cell] = first;
+  search_class(search, bounder, letters, classes_bounded);
+
+  letters[cell] = second;
+  search_class(search, bounder, letters, classes_bounded);
+
+  letters[cell] = all;
+}
+
+/* Fill in `board` with the letters of a class of single letters. */
+static void class_board(const vector<uint32_t> &letters, int xsize, int ysize,
+                        boggle_board &board)
+{
+  board.set_size(xsize, ysize);
+
+  for(int cell = 0; cell < xsize * ysize; cell++)
+    board.set(1 + cell / ysize, 1 + cell % ysize,
+              'a' + __builtin_ctz(letters[cell]));
+}
+
+/* Search every xsize by ysize board, of any letters, for the highest
+ * scoring one, by bounding the scores of classes of boards and
+ * splitting only the classes that might beat the best board found so
+ * far. Only boards scoring more than `best_score`, which can't be
+ * less than zero, are looked for; if one is already known, it's given
+ * in `best`.
+ *
+ * The search is split into CLASS_TASKS tasks, always the same ones
+ * for a board size: the class of every board, split in two the same
+ * way CLASS_TASKS times over. These are run across `pool`, skipping
+ * those marked in `done`, and `finished` is called with each one as
+ * it finishes. With those, a search can be stopped and carried on
+ * later. The calls to `finished` are made one at a time.
+ *
+ * Returns the best score found, and leaves that board in `best`. If
+ * `classes_bounded` is given, the number of classes bounded is added
+ * to it.
+ */
+int search_board_classes(optimizer_dictionary &od,
+                         int xsize, int ysize,
+                         int best_score,
+                         boggle_board &best,
+                         const vector<bool> &done,
+                         thread_pool &pool,
+                         const class_task_fn &finished,
+                         long *classes_bounded)
+{
+  int workers = pool.thread_count();
+  int cells = xsize * ysize;
+  class_search search;
+  vector<class_bounder *> bounders(workers);
+  vector<long> bounded(workers, 0);
+  mutex finished_lock;
+
+  search.xsize = xsize;
+  search.ysize = ysize;
+  search.best_score = best_score;
+
+  if ((best.xsize() == xsize) && (best.ysize() == ysize))
+    for(int cell = 0; cell < cells; cell++)
+      search.best_letters.push_back(1U << (best.ref(1 + cell / ysize,
+                                                    1 + cell % ysize) - 'a'));
+
+  for(int i = 0; i < workers; i++)
+    bounders[i] = new class_bounder(od, xsize, ysize);
+
+  pool.run(CLASS_TASKS, [&](int worker, int task) {
+      if (done[task])
+        return;
+
+      // The task's class, found by splitting the class of every
+      // board by the bits of the task number, highest first.
+      vector<uint32_t> letters(cells, (1U << 26) - 1);
+
+      for(int bit = CLASS_TASKS / 2; bit > 0; bit /= 2) {
+        int cell = split_cell(letters, xsize, ysize);
+
+        if (cell < 0) {
+          if (task & bit)
+            letters[0] = 0;
+
+          continue;
+        }
+
+        uint32_t first, second;
+
+        split_letters(letters[cell], first, second);
+        letters[cell] = (task & bit) ? second : first;
+      }
+
+      search_class(search, *bounders[worker], letters, bounded[worker]);
+
+      unique_lock<mutex> guard(finished_lock);
+      boggle_board board;
+      int score;
+
+      {
+        unique_lock<mutex> best_guard(search.lock);
+
+        score = search.best_score;
+
+        if (!search.best_letters.empty())
+          class_board(search.best_letters, xsize, ysize, board);
+      }
+
+      finished(task, score, board);
+    });
+
+  for(int i = 0; i < workers; i++) {
+    delete bounders[i];
+
+    if (classes_bounded)
+      *classes_bounded += bounded[i];
+  }
+
+  if (!search.best_letters.empty())
+    class_board(search.best_letters, xsize, ysize, best);
+
+  return search.best_score;
+}
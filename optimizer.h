@@ -0,0 +1,233 @@
+// Copyright (c) Mike Schaeffer. All rights reserved.
+//
+// The use and distribution terms for this software are covered by the
+// Eclipse Public License 2.0 (https://opensource.org/licenses/EPL-2.0)
+// which can be found in the file LICENSE at the root of this distribution.
+// By using this software in any fashion, you are agreeing to be bound by
+// the terms of this license.
+//
+// You must not remove this notice, or any other, from this software.
+
+/*
+ * optimizer.h - Searching for high scoring boards
+ * by Michael Schaeffer
+ */
+
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+#include "common.h"
+#include "dawg.h"
+#include "boggle_board.h"
+#include "score.h"
+#include "thread_pool.h"
+
+/* What every board_scorer on a dictionary shares, and only reads: the
+ * dictionary, how to score its words, and which words to ignore. One
+ * is shared by every chain of a search for high scoring boards, and
+ * by every solver that edits boards.
+ */
+class optimizer_dictionary {
+public:
+  static const uint32_t NO_EDGE = UINT32_MAX;
+
+  optimizer_dictionary(dawg &dict, score_table &scores);
+
+  void ignore(uint32_t id);
+
+private:
+  friend class board_scorer;
+  friend class class_bounder;
+
+  dawg &_dict;
+  score_table &_scores;
+  uint32_t _root_edges[27];        // The edge from the root for each letter
+  vector<uint8_t> _ignored;
+};
+
+/* A board_scorer keeps the score of a board up to date as its cells
+ * change one at a time.
+ *
+ * It keeps every path on the board that spells the prefix of a word,
+ * as a forest in which each prefix's parent is the one a cell shorter,
+ * and with a list of the prefixes ending on each cell. A word scores
+ * while at least one of those paths spells it. The paths through a
+ * cell are exactly the prefixes ending on it, and everything grown
+ * from them, so changing a cell only touches those: they are counted
+ * out and thrown away, and then regrown with the new letter from the
+ * prefixes ending next to the cell. The words whose counts reach or
+ * leave zero are the change's delta.
+ *
+ * letter_scores() scores every letter a cell could hold in one pass
+ * over the paths through it, without changing the board.
+ */
+class board_scorer {
+public:
+  board_scorer(optimizer_dictionary &od, int xsize, int ysize);
+
+  int xsize();
+  int ysize();
+  int cell_count();
+
+  void set_board(boggle_board &board);
+  void get_board(boggle_board &board);
+
+  char letter(int cell);
+  void set_letter(int cell, char letter);
+
+  int score();
+  void letter_scores(int cell, int *scores);
+
+  bool has_word(uint32_t id);
+  vector<uint32_t> &words_added();
+  vector<uint32_t> &words_removed();
+
+private:
+  static const int NO_LETTER = 26;  // In _letters, matching nothing
+  static const int NO_PREFIX = -1;
+
+  struct prefix {
+    int _cell;                     // The last cell of the path
+    uint32_t _node;                // ... and where it leads in the dawg
+    uint32_t _word_id;             // The id of the node's word, if any
+    int _depth;                    // The number of cells in the path
+
+    int _parent;
+    int _first_child;
+    int _next_sibling;             // Also links the free list
+    int _prev_sibling;
+    int _next_at_cell;
+    int _prev_at_cell;
+  };
+
+  void set_cell(int cell, int letter);
+  void set_neighbor_letters(int cell);
+
+  int add_prefix(int cell, uint32_t node, uint32_t word_id, int parent);
+  void free_prefix(int p);
+  void mark_path(int p, bool on);
+  bool is_visited(int cell);
+  void mark(int cell, bool on);
+
+  void grow(int p);
+  void count_out(int cell, bool remove);
+  void count_in(int cell);
+  void try_letters(int cell, uint32_t node, uint32_t word_id, int depth);
+  void tally(uint32_t id, int length, int sign);
+
+  optimizer_dictionary &_od;
+  int _xsize, _ysize, _cell_count;
+
+  vector<uint8_t> _letters;        // Each cell's letter, 0-25
+  vector<int> _neighbors;          // Eight slots per cell
+  vector<int> _neighbor_count;
+  vector<uint32_t> _neighbor_letters; // Letters next to each cell, as bits
+  vector<uint64_t> _visited;       // The cells on the current path
+
+  vector<prefix> _prefixes;
+  vector<int> _cell_prefixes;      // The first prefix ending on each cell
+  int _free_prefixes;
+  vector<int> _stack, _next_to;    // Scratch space
+
+  vector<uint32_t> _path_counts;   // Paths spelling each word
+  int _score;
+
+  vector<uint32_t> _added;         // What the last set_letter() changed
+  vector<uint32_t> _removed;
+
+  vector<uint32_t> _journal;       // Words counted out, to be put back
+  int _trial_letter;               // The cell's letter on this path
+  int _gains[26];                  // Points each letter would add
+  vector<uint32_t> _tried;         // Letters each word has added points for
+  vector<uint32_t> _tried_ids;
+};
+
+/* Search for the highest scoring xsize by ysize board by simulated
+ * annealing: `chains` independent chains of `steps` steps each, run
+ * across `pool`, each starting from a board drawn from
+ * counter_random(seed, chain). Each step scores every letter for one
+ * cell, and draws the cell's next letter with the better scoring ones
+ * more likely, the more so as the search cools.
+ * Returns the best score found, and leaves that board in `best`.
+ */
+int optimize_board(optimizer_dictionary &od,
+                   int xsize, int ysize,
+                   int chains, long steps, uint64_t seed,
+                   thread_pool &pool,
+                   boggle_board &best);
+
+/* A class_bounder finds upper bounds on the score of every board in a
+ * class of boards, one in which each cell may hold any of a set of
+ * letters. Two bounds are taken, and the lower one used:
+ *
+ * The sum bound is the total score of every word that can be spelled
+ * on any board in the class. Each board's words are among them.
+ *
+ * The max bound follows the paths from each cell, and at each cell
+ * takes the letter that gives the most points along the paths that
+ * continue through it, counting a word once for each path spelling
+ * it. Each board's score is at most the sum over its paths, and it
+ * has only one of the letters each cell may hold.
+ *
+ * Both are first taken over paths that may come back to cells
+ * they've already been through, so the paths ending at a cell with a
+ * given prefix can all be followed together, and a bound costs about
+ * as much as one walk of the dictionary. In classes of no more than
+ * MARKED_LETTERS letters to a cell, they're taken again over only the
+ * paths that never do, which is slower but much closer.
+ *
+ * Classes can only be bounded on boards of up to 32 cells. Once
+ * every cell has only one letter, score() gives the board's score.
+ */
+class class_bounder {
+public:
+  class_bounder(optimizer_dictionary &od, int xsize, int ysize);
+
+  int bound(const uint32_t *letters, int floor = -1);
+  int score(const uint32_t *letters);
+
+private:
+  static const int MARKED_LETTERS = 4;
+
+  void visit(uint32_t node, uint32_t word_id, int depth, uint32_t reach,
+             int *values);
+  int word_points(uint32_t edge, uint32_t word_id, int length);
+  int max_from(int cell, uint32_t node, uint32_t word_id, uint32_t visited,
+               int depth);
+
+  optimizer_dictionary &_od;
+  int _ysize;
+  int _cell_count;
+  uint32_t _neighbors[32];         // A bit for each neighbor of a cell
+  uint32_t _cells_with[26];        // A bit for each cell that may hold a letter
+
+  const uint32_t *_letters;        // The class being bounded
+  uint32_t _have, _doubled;        // The class's letters, and those in two cells
+  word_set _found;                 // Words spelled anywhere in the class
+  int _sum;
+
+  boggle_board _board;             // For scoring single boards
+};
+
+/* Called by search_board_classes as each task finishes, with the best
+ * board found so far by any task, and its score. */
+typedef function<void(int task, int best_score,
+                      boggle_board &best)> class_task_fn;
+
+/* The number of tasks search_board_classes splits a search into. */
+const int CLASS_TASKS = 1 << 16;
+
+int search_board_classes(optimizer_dictionary &od,
+                         int xsize, int ysize,
+                         int best_score,
+                         boggle_board &best,
+                         const vector<bool> &done,
+                         thread_pool &pool,
+                         const class_task_fn &finished,
+                         long *classes_bounded = NULL);
+
+#endif
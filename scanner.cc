@@ -0,0 +1,269 @@
+// Copyright (c) Mike Schaeffer. All rights reserved.
+//
+// The use and distribution terms for this software are covered by the
+// Eclipse Public License 2.0 (https://opensource.org/licenses/EPL-2.0)
+// which can be found in the file LICENSE at the root of this distribution.
+// By using this software in any fashion, you are agreeing to be bound by
+// the terms of this license.
+//
+// You must not remove this notice, or any other, from this software.
+
+/*
+ * scanner.cc - Fast buffered input for word lists and boards
+ * by Michael Schaeffer
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "scanner.h"
+
+/* These are used in place of isspace() and isalpha() so the inner
+ * scanning loops don't call into the C library for every character. */
+static inline bool is_space(char ch)
+{
+  return (ch == ' ') || ((ch >= '\t') && (ch <= '\r'));
+}
+
+static inline bool is_letter(char ch)
+{
+  return (unsigned)((ch | 0x20) - 'a') < 26;
+}
+
+scanner::scanner()
+{
+  _pos = _end = NULL;
+  _fd = -1;
+  _close_fd = false;
+  _map = NULL;
+  _map_size = 0;
+  _open = false;
+  _failed = false;
+}
+
+scanner::~scanner()
+{
+  close();
+}
+
+/* Open the file `filename` for scanning, or standard input if the name
+ * is "-". Returns FALSE if the file can't be opened. */
+bool scanner::open(const char *filename)
+{
+  close();
+
+  if (strcmp(filename, "-") == 0) {
+    _fd = 0;
+  } else {
+    _fd = ::open(filename, O_RDONLY);
+
+    if (_fd < 0)
+      return false;
+
+    _close_fd = true;
+
+    struct stat st;
+
+    if ((fstat(_fd, &st) == 0) && S_ISREG(st.st_mode) && (st.st_size > 0)) {
+      void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, _fd, 0);
+
+      if (map != MAP_FAILED) {
+        madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+        _map = map;
+        _map_size = st.st_size;
+        _pos = (const char *)map;
+        _end = _pos + _map_size;
+
+        ::close(_fd);
+        _fd = -1;
+        _close_fd = false;
+      }
+    }
+  }
+
+  if (_fd >= 0)
+    _buffer.resize(BLOCK_SIZE);
+
+  _open = true;
+  _failed = false;
+
+  return true;
+}
+
+/* Scan the `length` characters at `text`, which must stay put until
+ * the scanner is closed. */
+void scanner::open(const char *text, size_t length)
+{
+  close();
+
+  _pos = text;
+  _end = text + length;
+  _open = true;
+  _failed = false;
+}
+
+void scanner::close()
+{
+  if (_map != NULL)
+    munmap(_map, _map_size);
+
+  if (_close_fd)
+    ::close(_fd);
+
+  _pos = _end = NULL;
+  _fd = -1;
+  _close_fd = false;
+  _map = NULL;
+  _map_size = 0;
+  _open = false;
+}
+
+bool scanner::is_open()
+{
+  return _open;
+}
+
+void scanner::set_fail()
+{
+  _failed = true;
+}
+
+/* Read the next block of input into the buffer, once everything
+ * before it has been consumed. Returns FALSE at the end of the
+ * input. */
+bool scanner::refill()
+{
+  if (_fd < 0)
+    return false;
+
+  ssize_t length;
+
+  do {
+    length = read(_fd, &_buffer[0], _buffer.size());
+  } while ((length < 0) && (errno == EINTR));
+
+  if (length <= 0)
+    return false;
+
+  _pos = &_buffer[0];
+  _end = _pos + length;
+
+  return true;
+}
+
+void scanner::skip_whitespace()
+{
+  for(;;) {
+    while ((_pos < _end) && is_space(*_pos))
+      _pos++;
+
+    if ((_pos < _end) || !refill())
+      return;
+  }
+}
+
+/* Read a decimal integer, after any leading whitespace. */
+bool scanner::read_int(int &value)
+{
+  bool negative = false;
+  long result = 0;
+  int digits = 0;
+
+  skip_whitespace();
+
+  if (expect('-'))
+    negative = true;
+
+  for(int ch = peek(); (ch >= '0') && (ch <= '9'); ch = peek()) {
+    result = result * 10 + (ch - '0');
+    _pos++;
+
+    if (result > INT32_MAX)
+      return false;
+
+    digits++;
+  }
+
+  if (digits == 0)
+    return false;
+
+  value = negative ? -result : result;
+
+  return true;
+}
+
+/* Read a run of letters into `buf`, folding them to lower case, and
+ * return its length. A run too long to fit in `buf` (with its
+ * terminating null) is consumed all the same, and -1 returned. If the
+ * next character isn't a letter, nothing is consumed and 0 is
+ * returned. */
+int scanner::read_word(char *buf, int buf_size)
+{
+  int length = 0;
+
+  for(;;) {
+    const char *start = _pos;
+
+    while ((_pos < _end) && is_letter(*_pos))
+      _pos++;
+
+    for(const char *ch = start; ch < _pos; ch++, length++)
+      if (length < buf_size - 1)
+        buf[length] = *ch | 0x20;
+
+    if ((_pos < _end) || !refill())
+      break;
+  }
+
+  if (length >= buf_size) {
+    buf[0] = '\0';
+    return -1;
+  }
+
+  buf[length] = '\0';
+
+  return length;
+}
+
+/* Read a brace delimited group, including any groups nested inside it,
+ * into `text`. Leading whitespace is skipped. Returns FALSE if there's
+ * no group, or the input ends before it does. */
+bool scanner::read_group(string &text)
+{
+  int depth = 0;
+
+  text.clear();
+
+  skip_whitespace();
+
+  if (peek() != '{')
+    return false;
+
+  for(;;) {
+    const char *start = _pos;
+
+    while (_pos < _end) {
+      char ch = *_pos++;
+
+      if (ch == '{')
+        depth++;
+      else if ((ch == '}') && (--depth == 0))
+        break;
+    }
+
+    text.append(start, _pos - start);
+
+    if (depth == 0)
+      return true;
+
+    if (!refill())
+      return false;
+  }
+}
@@ -0,0 +1,118 @@
+// Copyright (c) Mike Schaeffer. All rights reserved.
+//
+// The use and distribution terms for this software are covered by the
+// Eclipse Public License 2.0 (https://opensource.org/licenses/EPL-2.0)
+// which can be found in the file LICENSE at the root of this distribution.
+// By using this software in any fashion, you are agreeing to be bound by
+// the terms of this license.
+//
+// You must not remove this notice, or any other, from this software.
+
+/*
+ * scanner.h - Fast buffered input for word lists and boards
+ * by Michael Schaeffer
+ */
+
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "common.h"
+
+/* A scanner reads text in bulk and hands it out a token at a time,
+ * in place of reading an istream a character at a time. Regular files
+ * are mapped into memory and scanned where they lie. Pipes and
+ * terminals are read a block at a time, and each block is used as
+ * soon as it arrives, so input can still be handled interactively. A
+ * scanner can also scan text that's already in memory.
+ *
+ * Like an istream, a scanner has a failure state, which the readers
+ * for word lists and boards set when they find malformed input.
+ */
+class scanner {
+public:
+  scanner();
+  ~scanner();
+
+  bool open(const char *filename);
+  void open(const char *text, size_t length);
+  void close();
+  bool is_open();
+
+  bool operator!();
+  explicit operator bool();
+  void set_fail();
+
+  int peek();
+  int get();
+  void skip_whitespace();
+  bool expect(char ch);
+
+  bool read_int(int &value);
+  int read_word(char *buf, int buf_size);
+  bool read_group(string &text);
+
+private:
+  scanner(const scanner &);
+  scanner &operator=(const scanner &);
+
+  bool refill();
+
+  static const size_t BLOCK_SIZE = 65536;
+
+  const char *_pos;          // The unread part of the current block
+  const char *_end;
+
+  int _fd;                   // The descriptor blocks are read from, or -1
+  bool _close_fd;
+  vector<char> _buffer;
+
+  void *_map;                // The mapped file being scanned, if any
+  size_t _map_size;
+
+  bool _open;
+  bool _failed;
+};
+
+inline bool scanner::operator!()
+{
+  return _failed;
+}
+
+inline scanner::operator bool()
+{
+  return !_failed;
+}
+
+/* Return the next character without consuming it, or EOF. */
+inline int scanner::peek()
+{
+  if ((_pos == _end) && !refill())
+    return EOF;
+
+  return (unsigned char)*_pos;
+}
+
+inline int scanner::get()
+{
+  if ((_pos == _end) && !refill())
+    return EOF;
+
+  return (unsigned char)*_pos++;
+}
+
+/* Consume the character `ch` if it's next, returning TRUE if it was. */
+inline bool scanner::expect(char ch)
+{
+  if (peek() != (unsigned char)ch)
+    return false;
+
+  _pos++;
+
+  return true;
+}
+
+#endif
@@ -0,0 +1,68 @@
+// Copyright (c) Mike Schaeffer. All rights reserved.
+//
+// The use and distribution terms for this software are covered by the
+// Eclipse Public License 2.0 (https://opensource.org/licenses/EPL-2.0)
+// which can be found in the file LICENSE at the root of this distribution.
+// By using this software in any fashion, you are agreeing to be bound by
+// the terms of this license.
+//
+// You must not remove this notice, or any other, from this software.
+
+/*
+ * score.cc - Scoring found words by length
+ * by Michael Schaeffer
+ */
+
+#include <ctype.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "score.h"
+
+/* tkboggle's default_scoring_table, indexed by word length. */
+static const int default_points[] = {
+  0, 0, 0, 0, 1, 2, 3, 5, 11, 22, 33, 44, 55, 66
+};
+
+score_table::score_table()
+{
+  _points.assign(default_points,
+                 default_points + sizeof(default_points) / sizeof(int));
+}
+
+/* Replace the table with the points listed in `text`, separated by
+ * commas or spaces, starting from words of no letters. Returns FALSE,
+ * leaving the table alone, unless `text` is a list of one or more
+ * numbers of points, none negative.
+ */
+bool score_table::parse(const char *text)
+{
+  vector<int> points;
+
+  for(;;) {
+    while ((*text == ',') || isspace((unsigned char)*text))
+      text++;
+
+    if (*text == '\0')
+      break;
+
+    if (!isdigit((unsigned char)*text))
+      return false;
+
+    char *end;
+    long value = strtol(text, &end, 10);
+
+    if (value > 1000000)
+      return false;
+
+    points.push_back(value);
+    text = end;
+  }
+
+  if (points.empty())
+    return false;
+
+  _points = points;
+
+  return true;
+}
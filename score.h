@@ -0,0 +1,47 @@
+// Copyright (c) Mike Schaeffer. All rights reserved.
+//
+// The use and distribution terms for this software are covered by the
+// Eclipse Public License 2.0 (https://opensource.org/licenses/EPL-2.0)
+// which can be found in the file LICENSE at the root of this distribution.
+// By using this software in any fashion, you are agreeing to be bound by
+// the terms of this license.
+//
+// You must not remove this notice, or any other, from this software.
+
+/*
+ * score.h - Scoring found words by length
+ * by Michael Schaeffer
+ */
+
+#ifndef SCORE_H
+#define SCORE_H
+
+#include <vector>
+
+#include "common.h"
+
+/* A score_table gives the points for a word by its length. The
+ * default table is tkboggle's default_scoring_table. Words longer than
+ * the table score as its last entry.
+ */
+class score_table {
+public:
+  score_table();
+
+  bool parse(const char *text);
+
+  int score(int length);
+
+private:
+  vector<int> _points;
+};
+
+inline int score_table::score(int length)
+{
+  if (length >= (int)_points.size())
+    length = _points.size() - 1;
+
+  return _points[length];
+}
+
+#endif
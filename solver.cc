@@ -0,0 +1,285 @@
+// Copyright (c) Mike Schaeffer. All rights reserved.
+//
+// The use and distribution terms for this software are covered by the
+// Eclipse Public License 2.0 (https://opensource.org/licenses/EPL-2.0)
+// which can be found in the file LICENSE at the root of this distribution.
+// By using this software in any fashion, you are agreeing to be bound by
+// the terms of this license.
+//
+// You must not remove this notice, or any other, from this software.
+
+/*
+ * solver.cc - The interface to libboggler, for solving boards in process
+ * by Michael Schaeffer
+ */
+
+#include <algorithm>
+
+#include "common.h"
+#include "wordtree.h"
+#include "dawg.h"
+#include "boggle_board.h"
+#include "scanner.h"
+#include "score.h"
+#include "optimizer.h"
+#include "solver.h"
+
+boggle_dictionary::boggle_dictionary()
+{
+  _paths = NULL;
+  _loaded = false;
+}
+
+boggle_dictionary::~boggle_dictionary()
+{
+  delete _paths;
+}
+
+/* Read a word list into `words`, returning FALSE if it can't be
+ * read. */
+static bool read_word_list(const char *filename, wordtree &words)
+{
+  scanner in;
+
+  return in.open(filename) && (bool)(in >> words);
+}
+
+/* Load the dictionary from `filename`, which may be either a word list
+ * or a compiled image. The words listed in `ignore_filename`, if it's
+ * given, are never reported by a solver. Returns FALSE if either file
+ * can't be read. A dictionary can only be loaded once.
+ */
+bool boggle_dictionary::load(const char *filename, const char *ignore_filename)
+{
+  if (_loaded)
+    return false;
+
+  wordtree ignored_words;
+
+  if (ignore_filename && !read_word_list(ignore_filename, ignored_words))
+    return false;
+
+  if (dawg::is_image(filename)) {
+    if (!_graph.map_image(filename))
+      return false;
+  } else {
+    wordtree words;
+
+    if (!read_word_list(filename, words))
+      return false;
+
+    _graph.build(words);
+  }
+
+  if (ignore_filename)
+    _graph.word_ids(ignored_words, _ignored_ids);
+
+  _paths = new optimizer_dictionary(_graph, _scores);
+
+  for(size_t i = 0; i < _ignored_ids.size(); i++)
+    _paths->ignore(_ignored_ids[i]);
+
+  _loaded = true;
+
+  return true;
+}
+
+bool boggle_dictionary::is_loaded()
+{
+  return _loaded;
+}
+
+int boggle_dictionary::word_count()
+{
+  return _graph.word_count();
+}
+
+/* Return the id of `word`, or dawg::NO_WORD if it isn't in the
+ * dictionary. */
+uint32_t boggle_dictionary::word_id(const char *word)
+{
+  return _graph.word_id(word);
+}
+
+/* Write the word with the given id into `buf`, which must hold
+ * MAX_WORD_SIZE characters. */
+bool boggle_dictionary::word(uint32_t id, char *buf)
+{
+  return _graph.word(id, buf);
+}
+
+/* The points words score by length, for boggle_solver::score() and
+ * edit(). This may be changed, with score_table::parse(), but not
+ * while any solver is using it. */
+score_table &boggle_dictionary::scores()
+{
+  return _scores;
+}
+
+boggle_solver::boggle_solver(boggle_dictionary &dict)
+  : _dict(dict)
+{
+  _words.set_word_count(dict.word_count());
+
+  for(size_t i = 0; i < dict._ignored_ids.size(); i++)
+    _words.ignore(dict._ignored_ids[i]);
+
+  _paths = NULL;
+  _paths_current = false;
+}
+
+boggle_solver::~boggle_solver()
+{
+  delete _paths;
+}
+
+/* Set the solver's own board to the given letters, returning FALSE
+ * if the size is invalid. */
+bool boggle_solver::fill_board(const char *letters, int xsize, int ysize)
+{
+  if ((xsize <= 0) || (ysize <= 0))
+    return false;
+
+  if ((_board.xsize() != xsize) || (_board.ysize() != ysize))
+    _board.set_size(xsize, ysize);
+
+  for(int x = 1; x <= xsize; x++)
+    for(int y = 1; y <= ysize; y++)
+      _board.set(x, y, *letters++);
+
+  return true;
+}
+
+/* Solve the `xsize` by `ysize` board whose letters are given by
+ * `letters`, in the order they appear in a board file: row by row,
+ * with `ysize` letters to a row. Returns the number of words found,
+ * or -1 if the size is invalid. */
+int boggle_solver::solve(const char *letters, int xsize, int ysize)
+{
+  if (!fill_board(letters, xsize, ysize))
+    return -1;
+
+  return solve(_board);
+}
+
+/* Solve `board`, returning the number of words found. The search
+ * uses scratch space kept in the board, so a board can't be solved by
+ * two threads at once. */
+int boggle_solver::solve(boggle_board &board)
+{
+  _paths_current = false;
+  _words.clear();
+
+  board.search_words(_dict._graph, _words);
+
+  return _words.size();
+}
+
+/* Solve the board given as for solve(letters, xsize, ysize), but
+ * return its score, or -1 if the size is invalid. */
+int boggle_solver::score(const char *letters, int xsize, int ysize)
+{
+  if (!fill_board(letters, xsize, ysize))
+    return -1;
+
+  return score(_board);
+}
+
+/* Solve `board`, returning its score. size() then gives the number of
+ * words found. */
+int boggle_solver::score(boggle_board &board)
+{
+  _paths_current = false;
+  _words.clear();
+
+  return board.score_words(_dict._graph, _words, _dict._scores);
+}
+
+/* The number of words found on the last board solved. */
+int boggle_solver::size()
+{
+  return _words.size();
+}
+
+/* The ids of the words found on the last board solved, in the order
+ * they were found. There are size() of them, and they stay valid
+ * until the next board is solved. */
+const uint32_t *boggle_solver::word_ids()
+{
+  return _words.ids().data();
+}
+
+/* Call `fn` with each word found on the last board solved, in
+ * alphabetical order. */
+void boggle_solver::for_each_word(const word_fn &fn)
+{
+  char buf[MAX_WORD_SIZE];
+  vector<uint32_t> &ids = _words.ids();
+
+  sort(ids.begin(), ids.end());
+
+  for(size_t i = 0; i < ids.size(); i++)
+    if (_dict.word(ids[i], buf))
+      fn(ids[i], buf);
+}
+
+/* Change the letter at (`x`, `y`) of the solver's own board, and
+ * bring the results up to date with it. Only the paths through that
+ * cell are searched again, so this is much cheaper than solving the
+ * board, except for the first edit after a solve(), which has to count
+ * every path on the board. Returns the number of words now found, or
+ * -1 if the cell isn't on the board.
+ */
+int boggle_solver::edit(int x, int y, char letter)
+{
+  if ((x < 1) || (x > _board.xsize()) || (y < 1) || (y > _board.ysize()))
+    return -1;
+
+  if (!_paths_current) {
+    if (_paths && ((_paths->xsize() != _board.xsize())
+                   || (_paths->ysize() != _board.ysize()))) {
+      delete _paths;
+      _paths = NULL;
+    }
+
+    if (_paths == NULL)
+      _paths = new board_scorer(*_dict._paths, _board.xsize(), _board.ysize());
+
+    // The last board solved may not have been this one.
+    solve(_board);
+
+    _paths->set_board(_board);
+    _paths_current = true;
+  }
+
+  _board.set(x, y, letter);
+  _paths->set_letter((x - 1) * _board.ysize() + (y - 1), letter);
+
+  _words.remove(_paths->words_removed());
+
+  vector<uint32_t> &added = _paths->words_added();
+
+  for(size_t i = 0; i < added.size(); i++)
+    _words.add(added[i]);
+
+  return _words.size();
+}
+
+/* The ids of the words the last edit() added to the results, and of
+ * those it took away. Both are empty if the last call was a solve(). */
+const vector<uint32_t> &boggle_solver::words_added()
+{
+  return _paths_current ? _paths->words_added() : _no_words;
+}
+
+const vector<uint32_t> &boggle_solver::words_removed()
+{
+  return _paths_current ? _paths->words_removed() : _no_words;
+}
+
+/* The solver's own board, which solve(letters, xsize, ysize) fills
+ * in. */
+boggle_board &boggle_solver::board()
+{
+  return _board;
+}
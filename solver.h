@@ -0,0 +1,125 @@
+// Copyright (c) Mike Schaeffer. All rights reserved.
+//
+// The use and distribution terms for this software are covered by the
+// Eclipse Public License 2.0 (https://opensource.org/licenses/EPL-2.0)
+// which can be found in the file LICENSE at the root of this distribution.
+// By using this software in any fashion, you are agreeing to be bound by
+// the terms of this license.
+//
+// You must not remove this notice, or any other, from this software.
+
+/*
+ * solver.h - The interface to libboggler, for solving boards in process
+ * by Michael Schaeffer
+ */
+
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+#include "common.h"
+#include "wordtree.h"
+#include "dawg.h"
+#include "boggle_board.h"
+#include "score.h"
+#include "optimizer.h"
+
+/* A boggle_dictionary is loaded once and then shared by any number of
+ * solvers, on any number of threads. Once loaded it is never
+ * modified, so sharing it needs no locking.
+ *
+ * Both text word lists and compiled images can be loaded. Either way
+ * the dictionary is held as a dawg, and found words are reported by
+ * their dawg word ids, which are also their positions in alphabetical
+ * order.
+ */
+class boggle_dictionary {
+public:
+  boggle_dictionary();
+  ~boggle_dictionary();
+
+  bool load(const char *filename, const char *ignore_filename = NULL);
+  bool is_loaded();
+
+  int word_count();
+  uint32_t word_id(const char *word);
+  bool word(uint32_t id, char *buf);
+
+  score_table &scores();
+
+private:
+  friend class boggle_solver;
+
+  boggle_dictionary(const boggle_dictionary &);
+  boggle_dictionary &operator=(const boggle_dictionary &);
+
+  dawg _graph;
+  vector<uint32_t> _ignored_ids;   // Words never reported as found
+  score_table _scores;
+  optimizer_dictionary *_paths;    // For solvers that edit boards
+  bool _loaded;
+};
+
+/* A boggle_solver finds the words of a dictionary on boards, one at a
+ * time. It owns all the scratch space a search needs and reuses it
+ * from one board to the next, so solving a board allocates nothing
+ * once the solver has seen a board of that size. A solver may only be
+ * used by one thread at a time; give each thread its own.
+ *
+ * Results are kept in the solver until the next board is solved. They
+ * can be read as a span of word ids, in the order they were found, or
+ * passed to a callback, in alphabetical order. The dictionary must be
+ * loaded before any solver is made from it.
+ *
+ * score() is solve() for callers that only want the total: each word
+ * is scored as the search finds it, by the dictionary's scores(), and
+ * no word is written out. The words found are still kept by id.
+ *
+ * Once a board is solved, edit() changes one of its letters and
+ * updates the results by re-solving only the paths through that cell.
+ * It keeps a count of the paths spelling each word to do this, which
+ * the first edit after a solve() has to build.
+ */
+class boggle_solver {
+public:
+  typedef function<void(uint32_t id, const char *word)> word_fn;
+
+  boggle_solver(boggle_dictionary &dict);
+  ~boggle_solver();
+
+  int solve(const char *letters, int xsize, int ysize);
+  int solve(boggle_board &board);
+
+  int score(const char *letters, int xsize, int ysize);
+  int score(boggle_board &board);
+
+  int size();
+  const uint32_t *word_ids();
+
+  void for_each_word(const word_fn &fn);
+
+  int edit(int x, int y, char letter);
+  const vector<uint32_t> &words_added();
+  const vector<uint32_t> &words_removed();
+
+  boggle_board &board();
+
+private:
+  boggle_solver(const boggle_solver &);
+  boggle_solver &operator=(const boggle_solver &);
+
+  bool fill_board(const char *letters, int xsize, int ysize);
+
+  boggle_dictionary &_dict;
+  boggle_board _board;
+  word_set _words;
+
+  board_scorer *_paths;            // Kept up to date by edit()
+  bool _paths_current;
+  vector<uint32_t> _no_words;
+};
+
+#endif
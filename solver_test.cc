@@ -0,0 +1,710 @@
+// Copyright (c) Mike Schaeffer. All rights reserved.
+//
+// The use and distribution terms for this software are covered by the
+// Eclipse Public License 2.0 (https://opensource.org/licenses/EPL-2.0)
+// which can be found in the file LICENSE at the root of this distribution.
+// By using this software in any fashion, you are agreeing to be bound by
+// the terms of this license.
+//
+// You must not remove this notice, or any other, from this software.
+
+/*
+ * solver_test.cc - Regression tests for libboggler
+ * by Michael Schaeffer
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sstream>
+
+#include "common.h"
+#include "wordtree.h"
+#include "dawg.h"
+#include "boggle_board.h"
+#include "scanner.h"
+#include "score.h"
+#include "thread_pool.h"
+#include "optimizer.h"
+#include "solver.h"
+
+static const char *word_list = "wordlist-small";
+static const char *large_word_list = "wordlist-large";
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+  if (!ok) {
+    fprintf(stderr, "FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+/* Write `text` to a new temporary file, and return its name, which
+ * the caller frees. */
+static char *temp_file(const char *text)
+{
+  char *name = strdup("/tmp/solver_test.XXXXXX");
+  int fd = mkstemp(name);
+
+  if ((fd < 0) || (write(fd, text, strlen(text)) != (ssize_t)strlen(text))) {
+    fprintf(stderr, "FAIL: can't write %s\n", name);
+    exit(1);
+  }
+
+  close(fd);
+
+  return name;
+}
+
+/* Read the words in `file` into `words`, and build `graph` from them. */
+static void read_words(const char *file, wordtree &words, dawg &graph)
+{
+  scanner in;
+
+  check(in.open(file) && (bool)(in >> words), "word list reads");
+  graph.build(words);
+}
+
+/* Return the words in `words`, as they'd be written out. */
+static string words_of(wordtree &words)
+{
+  ostringstream o;
+
+  o << words;
+
+  return o.str();
+}
+
+/* Return true if `a` and `b` hold the same words. */
+static bool same_words(word_set &a, word_set &b)
+{
+  if (a.size() != b.size())
+    return false;
+
+  for(size_t i = 0; i < a.ids().size(); i++)
+    if (!b.contains(a.ids()[i]))
+      return false;
+
+  return true;
+}
+
+/* Every word in a dawg should have an id that maps back to it. */
+static void test_word_ids()
+{
+  wordtree words;
+  dawg graph;
+  char buf[MAX_WORD_SIZE];
+  bool round_trips = true;
+
+  read_words(word_list, words, graph);
+
+  check(graph.word_count() == words.word_count(),
+        "the dawg has every word in the word list");
+
+  for(int id = 0; id < graph.word_count(); id++)
+    if (!graph.word(id, buf) || (graph.word_id(buf) != (uint32_t)id))
+      round_trips = false;
+
+  check(round_trips, "word ids map to words and back");
+  check(graph.word_id("qqq") == dawg::NO_WORD, "word_id refuses a non-word");
+  check(!graph.word(graph.word_count(), buf), "word refuses an id out of range");
+}
+
+/* A dawg written to an image and mapped back should hold the same
+ * words, and an image that's been damaged should be refused. */
+static void test_image()
+{
+  wordtree words;
+  dawg graph, mapped, damaged;
+  char *image = temp_file("");
+
+  read_words(word_list, words, graph);
+
+  check(graph.write_image(image), "write_image writes an image");
+  check(dawg::is_image(image), "is_image knows an image");
+  check(!dawg::is_image(word_list), "is_image knows a word list isn't one");
+  check(mapped.map_image(image), "map_image maps an image");
+  check(mapped.word_count() == graph.word_count(),
+        "a mapped image has the same words");
+  check((mapped.word_id("acts") != dawg::NO_WORD)
+        && (mapped.word_id("acts") == graph.word_id("acts")),
+        "a mapped image has the same word ids");
+
+  // Flip one byte near the end, in the body of the image.
+  FILE *f = fopen(image, "r+b");
+
+  check(f && !fseek(f, -4, SEEK_END), "the image reopens");
+
+  if (f) {
+    int ch = fgetc(f);
+
+    fseek(f, -4, SEEK_END);
+    fputc(ch ^ 0xff, f);
+    fclose(f);
+  }
+
+  check(!damaged.map_image(image), "map_image refuses a damaged image");
+
+  // And cut the image short.
+  check(truncate(image, 64) == 0, "the image is cut short");
+  check(!damaged.map_image(image), "map_image refuses a short image");
+
+  unlink(image);
+  free(image);
+}
+
+/* A word too long for the buffer it's read into is skipped whole, and
+ * reading goes on with the next one. */
+static void test_long_words()
+{
+  string text = "Ab " + string(MAX_WORD_SIZE - 1, 'x') + " "
+    + string(MAX_WORD_SIZE, 'y') + " cd";
+  char buf[MAX_WORD_SIZE];
+  scanner in;
+
+  in.open(text.data(), text.size());
+
+  check((in.read_word(buf, MAX_WORD_SIZE) == 2) && !strcmp(buf, "ab"),
+        "read_word reads a word, folded to lower case");
+
+  in.skip_whitespace();
+  check(in.read_word(buf, MAX_WORD_SIZE) == MAX_WORD_SIZE - 1,
+        "read_word reads a word that just fits");
+
+  in.skip_whitespace();
+  check(in.read_word(buf, MAX_WORD_SIZE) == -1,
+        "read_word refuses a word too long to fit");
+
+  in.skip_whitespace();
+  check((in.read_word(buf, MAX_WORD_SIZE) == 2) && !strcmp(buf, "cd"),
+        "read_word reads on past a word too long to fit");
+
+  // A word list keeps the words around the one it skips.
+  string list = "{ab " + string(MAX_WORD_SIZE + 8, 'z') + " cd}";
+  wordtree words;
+
+  in.open(list.data(), list.size());
+
+  check((bool)(in >> words) && (words.word_count() == 2),
+        "a word list skips a word too long to fit");
+}
+
+/* Fill `found` with the ids of the words in `words`. */
+static void word_set_of(dawg &graph, wordtree &words, word_set &found)
+{
+  vector<uint32_t> ids;
+
+  found.set_word_count(graph.word_count());
+  graph.word_ids(words, ids);
+
+  for(size_t i = 0; i < ids.size(); i++)
+    found.add(ids[i]);
+}
+
+/* The iterative search should find the same words as the recursive
+ * one, on one thread or several, on boards of any shape. */
+static void test_iterative_search()
+{
+  wordtree words;
+  dawg graph;
+  thread_pool pool(3);
+  counter_random random(7, 0);
+  bool same = true, same_pooled = true;
+  int total = 0;
+
+  read_words(large_word_list, words, graph);
+
+  for(int i = 0; i < 24; i++) {
+    boggle_board board;
+    wordtree tree;
+    word_set expected, found, pooled;
+
+    board.set_size(1 + i % 6, 1 + i / 4);
+    board.shuffle(random);
+
+    board.find_words(graph, tree);
+    word_set_of(graph, tree, expected);
+
+    found.set_word_count(graph.word_count());
+    pooled.set_word_count(graph.word_count());
+
+    board.search_words(graph, found);
+    board.search_words(graph, pooled, pool);
+
+    same = same && same_words(expected, found);
+    same_pooled = same_pooled && same_words(expected, pooled);
+    total += expected.size();
+  }
+
+  check(total > 0, "find_words finds words on the random boards");
+  check(same, "search_words finds the same words as find_words");
+  check(same_pooled,
+        "search_words finds the same words as find_words with a pool");
+}
+
+/* Skipping the parts of the dictionary that need letters the board
+ * doesn't have, or has only once, should never lose a word that's on
+ * the board. */
+static void test_pruning()
+{
+  char *file = temp_file("{noon not onto otto toot ton tot}");
+  wordtree words;
+  dawg graph;
+  counter_random random(11, 0);
+  bool same = true;
+  int total = 0;
+
+  read_words(file, words, graph);
+  unlink(file);
+  free(file);
+
+  for(int i = 0; i < 200; i++) {
+    boggle_board board;
+    wordtree tree;
+    word_set expected, found;
+
+    board.set_size(2 + i % 3, 2 + i % 2);
+
+    for(int x = 1; x <= board.xsize(); x++)
+      for(int y = 1; y <= board.ysize(); y++)
+        board.set(x, y, "nota"[random.limited(4)]);
+
+    // The search of the wordtree doesn't prune.
+    board.find_words(words, tree);
+    word_set_of(graph, tree, expected);
+
+    found.set_word_count(graph.word_count());
+    board.search_words(graph, found);
+
+    same = same && same_words(expected, found);
+    total += expected.size();
+  }
+
+  check(total > 0, "find_words finds words on the pruning boards");
+  check(same, "pruning by the board's letters loses no words");
+}
+
+/* A word_set holds each word once, in the order it was added, and
+ * never holds the words it ignores. */
+static void test_word_set()
+{
+  word_set set;
+  vector<uint32_t> gone;
+
+  set.set_word_count(200);
+  set.ignore(5);
+
+  check(set.add(70) && set.add(3) && !set.add(70),
+        "a word_set adds each word once");
+  check(!set.add(5) && set.contains(5), "a word_set never adds an ignored word");
+  check((set.size() == 2) && (set.ids()[0] == 70) && (set.ids()[1] == 3),
+        "a word_set keeps its words in the order they were added");
+
+  set.add(199);
+  gone.push_back(3);
+  set.remove(gone);
+
+  check((set.size() == 2) && (set.ids()[0] == 70) && (set.ids()[1] == 199)
+        && !set.contains(3), "remove keeps the other words in order");
+
+  set.clear();
+
+  check((set.size() == 0) && !set.contains(70) && set.contains(5),
+        "clear empties a word_set, but keeps its ignored words");
+  check(set.add(70), "a cleared word_set adds words again");
+}
+
+/* Read the word list `text` into `words`. */
+static void parse_words(const char *text, wordtree &words)
+{
+  scanner in;
+
+  in.open(text, strlen(text));
+  check((bool)(in >> words), "word list parses");
+}
+
+/* Words found in a merged dictionary should be written for each
+ * lexicon they're in, and only those, less the lexicon's ignored
+ * words. */
+static void test_lexicons()
+{
+  wordtree first, second, ignored, all_words;
+  dawg graph;
+  lexicon_masks lexicons;
+  vector<uint32_t> ids;
+
+  parse_words("{acts cast cats}", first);
+  parse_words("{cats scat tacs}", second);
+  parse_words("{scat}", ignored);
+
+  all_words.insert_words(first);
+  all_words.insert_words(second);
+  graph.build(all_words);
+  lexicons.set_word_count(graph.word_count());
+
+  graph.word_ids(first, ids);
+  lexicons.add(0, ids);
+
+  ids.clear();
+  graph.word_ids(second, ids);
+  lexicons.add(1, ids);
+
+  ids.clear();
+  graph.word_ids(ignored, ids);
+  lexicons.remove(1, ids);
+
+  check(lexicons.mask(graph.word_id("cats")) == 3,
+        "a word in two lexicons is in both");
+
+  boggle_board board;
+  word_set found;
+  ostringstream o0, o1;
+  istringstream in("{{2 2}{c a}{s t}}");
+
+  in >> board;
+  found.set_word_count(graph.word_count());
+  board.search_words(graph, found);
+
+  graph.write_words(o0, found, 0, lexicons);
+  graph.write_words(o1, found, 1, lexicons);
+
+  check(o0.str() == "{acts cast cats }", "the first lexicon's words are written");
+  check(o1.str() == "{cats tacs }",
+        "the second lexicon's words are written, less those ignored");
+}
+
+/* Return the words `board` has from `version`. */
+static string version_words(boggle_board &board, word_version *version)
+{
+  wordtree found;
+
+  board.find_words(*version, found);
+
+  return words_of(found);
+}
+
+/* Each change to a word_versions should make a new version with the
+ * change, and leave a version already being searched as it was. */
+static void test_word_versions()
+{
+  wordtree words, added, removed, fresh;
+  boggle_board board;
+  istringstream in("{{2 2}{c a}{s t}}");
+
+  in >> board;
+  parse_words("{acts cast}", words);
+  parse_words("{cats}", added);
+  parse_words("{acts}", removed);
+  parse_words("{scat tacs}", fresh);
+
+  word_versions versions(words, 2);
+  word_version *first = versions.enter(0);
+  uint64_t number = first->number();
+
+  check(version_words(board, first) == "{acts cast }",
+        "the first version has the words it was made with");
+
+  check(versions.update(added, removed) > number,
+        "update makes a newer version");
+
+  word_version *second = versions.enter(1);
+
+  check(version_words(board, second) == "{cast cats }",
+        "update adds and removes words");
+  check(version_words(board, first) == "{acts cast }",
+        "update leaves a version being searched as it was");
+
+  versions.leave(0);
+  versions.leave(1);
+
+  versions.replace(fresh);
+
+  check(version_words(board, versions.enter(0)) == "{scat tacs }",
+        "replace makes a version with only the new words");
+
+  versions.leave(0);
+}
+
+/* Solving a board across a pool of threads should find the same words
+ * as solving it on one. */
+static void test_pooled_solve()
+{
+  wordtree words;
+  dawg graph;
+  thread_pool pool(4);
+  boggle_board board;
+  istringstream in("{{4 4}{e n s n}{i h j p}{e e r r}{r g s u}}");
+
+  read_words(large_word_list, words, graph);
+  in >> board;
+
+  wordtree serial, pooled, graph_pooled;
+
+  board.find_words(words, serial);
+  board.find_words(words, pooled, pool);
+  board.find_words(graph, graph_pooled, pool);
+
+  check(serial.word_count() > 0, "find_words finds words");
+  check(words_of(serial) == words_of(pooled),
+        "find_words finds the same words with a pool");
+  check(words_of(serial) == words_of(graph_pooled),
+        "find_words finds the same words in a dawg with a pool");
+
+  // A word that was missed while the marks were indexed without the
+  // board's border.
+  dawg found;
+
+  found.build(pooled);
+  check(found.word_id("erg") != dawg::NO_WORD, "find_words finds erg");
+
+  // Tiles of a large board, searched in parallel, should add up to
+  // the same words as the whole board.
+  counter_random random(42, 0);
+  word_set whole, tiled;
+  int reported = 0;
+
+  board.set_size(40, 40);
+  board.shuffle(random);
+
+  whole.set_word_count(graph.word_count());
+  tiled.set_word_count(graph.word_count());
+
+  board.search_words(graph, whole);
+  board.search_tiles(graph, tiled, 8, pool, [&](const vector<uint32_t> &ids) {
+      reported += ids.size();
+    });
+
+  check(same_words(whole, tiled),
+        "search_tiles finds the same words as a full search");
+  check(reported == tiled.size(), "search_tiles reports each word once");
+}
+
+/* Solving boards a group at a time should find, and score, the same
+ * words as solving them one at a time, whatever their sizes, including
+ * boards too big to share a walk of the dictionary. */
+static void test_group_search()
+{
+  const int lanes = boggle_board::GROUP_LANES;
+  wordtree words;
+  dawg graph;
+  score_table scores;
+  counter_random random(23, 0);
+  boggle_board boards[lanes];
+  word_set found[lanes], scored[lanes];
+  int points[lanes];
+  bool same = true, same_points = true;
+  int total = 0;
+
+  read_words(large_word_list, words, graph);
+
+  for(int i = 0; i < lanes; i++) {
+    boards[i].set_size(2 + i % 5, 2 + i / 3);
+    boards[i].shuffle(random);
+
+    found[i].set_word_count(graph.word_count());
+    scored[i].set_word_count(graph.word_count());
+  }
+
+  boggle_board::search_group(graph, boards, found, lanes);
+  boggle_board::search_group(graph, boards, scored, lanes, &scores, points);
+
+  for(int i = 0; i < lanes; i++) {
+    word_set expected;
+
+    expected.set_word_count(graph.word_count());
+
+    int score = boards[i].score_words(graph, expected, scores);
+
+    same = same && same_words(expected, found[i])
+      && same_words(expected, scored[i]);
+    same_points = same_points && (points[i] == score);
+    total += expected.size();
+  }
+
+  check(total > 0, "search_words finds words on the group's boards");
+  check(same, "search_group finds the same words as search_words");
+  check(same_points, "search_group scores boards as score_words does");
+}
+
+/* Editing a letter should leave the solver with the same words as
+ * solving the edited board from scratch, and report the change. */
+static void test_edit(boggle_dictionary &dict)
+{
+  boggle_solver solver(dict), fresh(dict);
+  int before = solver.solve("catatsred", 3, 3);
+
+  check(before > 0, "solve finds words on catatsred");
+
+  int after = solver.edit(2, 2, 'e');
+
+  check(after == fresh.solve("cataesred", 3, 3),
+        "edit finds the same words as a fresh solve");
+  check(after == before + (int)solver.words_added().size()
+        - (int)solver.words_removed().size(),
+        "edit reports the words added and removed");
+  check(solver.board().ref(2, 2) == 'e', "edit changes the board");
+
+  // A second edit reuses the path counts built by the first.
+  after = solver.edit(1, 1, 'b');
+
+  check(after == fresh.solve("bataesred", 3, 3),
+        "a second edit finds the same words as a fresh solve");
+  check(solver.edit(4, 1, 'a') == -1, "edit refuses a cell off the board");
+}
+
+/* A letter that starts no word can still continue words from the
+ * cells next to it, and an edit to it has to find those too. */
+static void test_edit_continuing_letter()
+{
+  char *words = temp_file("{ab abc qab}");
+  boggle_dictionary dict;
+  scanner in;
+  wordtree tree;
+  dawg graph;
+
+  check(dict.load(words), "the small word list loads");
+  check(in.open(words) && (bool)(in >> tree), "the small word list reads");
+  graph.build(tree);
+
+  unlink(words);
+  free(words);
+
+  boggle_solver solver(dict), fresh(dict);
+
+  solver.solve("abz", 1, 3);
+
+  check(solver.edit(1, 3, 'c') == fresh.solve("abc", 1, 3),
+        "edit to a letter starting no word finds words ending on it");
+  check(solver.edit(1, 1, 'q') == fresh.solve("qbc", 1, 3),
+        "edit away from a letter continuing words");
+
+  // Annealing changes every cell many times over, and checks its
+  // score against a recount as it goes.
+  score_table scores;
+  thread_pool pool(1);
+  boggle_board best;
+
+  scores.parse("0,0,1,5");
+
+  optimizer_dictionary od(graph, scores);
+
+  optimize_board(od, 2, 2, 1, 2000, 1, pool, best);
+}
+
+/* The board the optimizer returns should be of the size asked for,
+ * and score what the optimizer says it does. */
+static void test_optimize(boggle_dictionary &dict)
+{
+  wordtree words;
+  dawg graph;
+  score_table scores;
+  thread_pool pool(2);
+  boggle_board best;
+
+  read_words(word_list, words, graph);
+
+  optimizer_dictionary od(graph, scores);
+  int score = optimize_board(od, 4, 3, 2, 2000, 3, pool, best);
+
+  check((best.xsize() == 4) && (best.ysize() == 3),
+        "optimize returns a board of the size asked for");
+
+  boggle_solver solver(dict);
+
+  check(score > 0, "optimize finds a board that scores");
+  check(score == solver.score(best), "optimize returns the best board's score");
+}
+
+/* A dictionary laid out again for a profile of boards, then written to
+ * an image and mapped back, should solve every board as it did before. */
+static void test_reordered_image()
+{
+  wordtree words;
+  dawg graph, profiled, mapped;
+  search_stats stats;
+  counter_random random(25, 0);
+  boggle_board board;
+  word_set found, mapped_found;
+  char *image = temp_file("");
+
+  read_words(large_word_list, words, graph);
+  profiled.build(words);
+
+  found.set_word_count(profiled.word_count());
+  stats._node_visits.assign(profiled.node_count(), 0);
+  board.set_stats(&stats);
+  board.set_size(4);
+
+  for(int i = 0; i < 50; i++) {
+    board.shuffle(random);
+    found.clear();
+    board.search_words(profiled, found);
+  }
+
+  board.set_stats(NULL);
+  profiled.reorder(stats._node_visits);
+
+  check(profiled.write_image(image) && mapped.map_image(image),
+        "a reordered dictionary writes an image that maps");
+
+  unlink(image);
+  free(image);
+
+  bool same = true;
+
+  found.set_word_count(graph.word_count());
+  mapped_found.set_word_count(mapped.word_count());
+
+  for(int i = 0; i < 50; i++) {
+    ostringstream expected, actual;
+
+    board.set_size(3 + i % 4, 3 + i % 3);
+    board.shuffle(random);
+
+    found.clear();
+    mapped_found.clear();
+    board.search_words(graph, found);
+    board.search_words(mapped, mapped_found);
+
+    graph.write_words(expected, found);
+    mapped.write_words(actual, mapped_found);
+
+    same = same && (expected.str() == actual.str());
+  }
+
+  check(same, "a reordered image finds the same words as the original");
+}
+
+int main(int argc, char **argv)
+{
+  boggle_dictionary dict;
+
+  if (!dict.load(word_list)) {
+    fprintf(stderr, "FAIL: can't load %s\n", word_list);
+    return 1;
+  }
+
+  test_word_ids();
+  test_image();
+  test_long_words();
+  test_pooled_solve();
+  test_iterative_search();
+  test_word_set();
+  test_pruning();
+  test_lexicons();
+  test_word_versions();
+  test_group_search();
+  test_edit(dict);
+  test_edit_continuing_letter();
+  test_optimize(dict);
+  test_reordered_image();
+
+  if (failures == 0)
+    printf("All tests passed.\n");
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,226 @@
+// Copyright (c) Mike Schaeffer. All rights reserved.
+//
+// The use and distribution terms for this software are covered by the
+// Eclipse Public License 2.0 (https://opensource.org/licenses/EPL-2.0)
+// which can be found in the file LICENSE at the root of this distribution.
+// By using this software in any fashion, you are agreeing to be bound by
+// the terms of this license.
+//
+// You must not remove this notice, or any other, from this software.
+
+/*
+ * thread_pool.cc - A fixed pool of work-stealing worker threads
+ * by Michael Schaeffer
+ */
+
+#include <assert.h>
+
+#include <memory>
+
+#include "common.h"
+#include "thread_pool.h"
+
+thread_pool::thread_pool(int thread_count)
+{
+  assert(thread_count > 0);
+
+  _next_queue = 0;
+  _pending_jobs = 0;
+  _stopping = false;
+
+  for(int worker = 0; worker < thread_count; worker++)
+    _queues.push_back(new job_queue);
+
+  for(int worker = 1; worker < thread_count; worker++)
+    _threads.push_back(thread(&thread_pool::worker_main, this, worker));
+}
+
+thread_pool::~thread_pool()
+{
+  {
+    unique_lock<mutex> guard(_lock);
+
+    _stopping = true;
+  }
+
+  _work_ready.notify_all();
+
+  for(size_t i = 0; i < _threads.size(); i++)
+    _threads[i].join();
+
+  for(size_t i = 0; i < _queues.size(); i++)
+    delete _queues[i];
+}
+
+int thread_pool::thread_count()
+{
+  return _queues.size();
+}
+
+/* Queue a job to be run by some worker. Jobs are dealt out to the
+ * workers' queues in turn. */
+void thread_pool::submit(const job_fn &job)
+{
+  job_queue *queue = _queues[_next_queue++ % _queues.size()];
+
+  {
+    unique_lock<mutex> guard(_lock);
+
+    // Counted before it's queued, so a worker taking it can't count
+    // it out first.
+    _pending_jobs++;
+
+    unique_lock<mutex> queue_guard(queue->_lock);
+
+    queue->_jobs.push_back(job);
+  }
+
+  _work_ready.notify_one();
+}
+
+/* Find a job for `worker`: the oldest job in its own queue if there
+ * is one, otherwise the newest job in some other worker's queue.
+ * Returns false if every queue is empty. */
+bool thread_pool::take_job(int worker, job_fn &job)
+{
+  if (_pending_jobs == 0)
+    return false;
+
+  int queue_count = _queues.size();
+
+  for(int i = 0; i < queue_count; i++) {
+    job_queue *queue = _queues[(worker + i) % queue_count];
+    unique_lock<mutex> guard(queue->_lock);
+
+    if (queue->_jobs.empty())
+      continue;
+
+    if (i == 0) {
+      job = queue->_jobs.front();
+      queue->_jobs.pop_front();
+    } else {
+      job = queue->_jobs.back();
+      queue->_jobs.pop_back();
+    }
+
+    _pending_jobs--;
+
+    return true;
+  }
+
+  return false;
+}
+
+/* The body of each helper thread: run jobs until the pool is
+ * destroyed, sleeping whenever there's nothing to do. */
+void thread_pool::worker_main(int worker)
+{
+  job_fn job;
+
+  for(;;) {
+    if (take_job(worker, job)) {
+      job(worker);
+      continue;
+    }
+
+    unique_lock<mutex> guard(_lock);
+
+    while (!_stopping && (_pending_jobs == 0))
+      _work_ready.wait(guard);
+
+    if (_stopping)
+      return;
+  }
+}
+
+/* Run one pending job on the owning thread, as worker 0. Returns
+ * false if there was nothing to run. */
+bool thread_pool::run_one()
+{
+  job_fn job;
+
+  if (!take_job(0, job))
+    return false;
+
+  job(0);
+
+  return true;
+}
+
+/* What the workers running the tasks of one run() share. The helper
+ * jobs hold on to it, since a job may only be taken from its queue
+ * after run() has returned. */
+struct run_state {
+  atomic<int> next_task;
+  int task_count;
+  const thread_pool::task_fn *task;
+
+  mutex lock;
+  condition_variable helpers_done;
+  int running_helpers;             // Helpers partway through the tasks
+  bool finished;                   // Set once no helper may start
+};
+
+/* Run tasks from `state` as `worker` until there are none left. */
+static void drain(run_state &state, int worker)
+{
+  for(;;) {
+    int i = state.next_task.fetch_add(1);
+
+    if (i >= state.task_count)
+      break;
+
+    (*state.task)(worker, i);
+  }
+}
+
+/* Run task(worker, i) for every i in [0, task_count), returning once
+ * all of them have finished. `worker` identifies the thread running
+ * the task, in [0, thread_count()), so callers can give each thread
+ * its own scratch space. Tasks are claimed one at a time as workers
+ * come free.
+ *
+ * Helpers that haven't started by the time the owning thread runs out
+ * of tasks do nothing when they do start, so the owner only waits for
+ * the tasks already under way, and never runs another caller's jobs.
+ */
+void thread_pool::run(int task_count, const task_fn &task)
+{
+  shared_ptr<run_state> state = make_shared<run_state>();
+
+  state->next_task = 0;
+  state->task_count = task_count;
+  state->task = &task;
+  state->running_helpers = 0;
+  state->finished = false;
+
+  int helpers = min(thread_count(), task_count) - 1;
+
+  for(int i = 0; i < helpers; i++)
+    submit([state](int worker) {
+        {
+          unique_lock<mutex> guard(state->lock);
+
+          if (state->finished)
+            return;
+
+          state->running_helpers++;
+        }
+
+        drain(*state, worker);
+
+        unique_lock<mutex> guard(state->lock);
+
+        if (--state->running_helpers == 0)
+          state->helpers_done.notify_one();
+      });
+
+  drain(*state, 0);
+
+  unique_lock<mutex> guard(state->lock);
+
+  state->finished = true;
+
+  while (state->running_helpers > 0)
+    state->helpers_done.wait(guard);
+}
@@ -0,0 +1,77 @@
+// Copyright (c) Mike Schaeffer. All rights reserved.
+//
+// The use and distribution terms for this software are covered by the
+// Eclipse Public License 2.0 (https://opensource.org/licenses/EPL-2.0)
+// which can be found in the file LICENSE at the root of this distribution.
+// By using this software in any fashion, you are agreeing to be bound by
+// the terms of this license.
+//
+// You must not remove this notice, or any other, from this software.
+
+/*
+ * thread_pool.h - A fixed pool of work-stealing worker threads
+ * by Michael Schaeffer
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+
+/* A thread_pool runs jobs across a fixed set of workers. Each worker
+ * has its own queue of jobs, and a worker whose queue runs dry steals
+ * from the others, so jobs of very different lengths still balance
+ * out.
+ *
+ * Worker 0 is the thread that owns the pool. It has a queue like the
+ * others, but only takes jobs from the queues when it calls run_one(),
+ * and only runs tasks when it calls run(), so a pool of one thread runs
+ * everything inline. Those two calls, and submit(), should only be
+ * made from the owning thread.
+ */
+class thread_pool {
+public:
+  typedef function<void(int worker)> job_fn;
+  typedef function<void(int worker, int task)> task_fn;
+
+  thread_pool(int thread_count);
+  ~thread_pool();
+
+  int thread_count();
+
+  void submit(const job_fn &job);
+  bool run_one();
+
+  void run(int task_count, const task_fn &task);
+
+private:
+  struct job_queue {
+    mutex _lock;
+    deque<job_fn> _jobs;
+  };
+
+  thread_pool(const thread_pool &);
+  thread_pool &operator=(const thread_pool &);
+
+  bool take_job(int worker, job_fn &job);
+  void worker_main(int worker);
+
+  vector<thread> _threads;
+  vector<job_queue *> _queues;
+  unsigned _next_queue;
+
+  mutex _lock;
+  condition_variable _work_ready;
+  atomic<int> _pending_jobs;
+  bool _stopping;
+};
+
+#endif
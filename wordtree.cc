@@ -14,10 +14,105 @@
  */
 
 #include <assert.h>
+#include <ctype.h>
 #include <string.h>
 
+#include <new>
+
 #include "common.h"
 #include "wordtree.h"
+#include "scanner.h"
+
+wordtree::wordtree()
+{
+  _current_slab = 0;
+  _slab_used = 0;
+
+  for(int i = 0; i <= 26; i++)
+    _free_runs[i] = NULL;
+
+  _node_count = 0;
+}
+
+wordtree::~wordtree()
+{
+  for(size_t i = 0; i < _slabs.size(); i++)
+    ::operator delete(_slabs[i]);
+}
+
+/* Take a run of `count` nodes, reusing a run of that length that was
+ * outgrown if there is one, and otherwise carving it out of the
+ * current slab. If the slab hasn't room for the run, the rest of it
+ * goes unused and the run comes from the next slab, which is
+ * allocated if need be. The nodes aren't initialized. */
+wordtree::wt_node *wordtree::new_nodes(int count)
+{
+  if (_free_runs[count]) {
+    wt_node *nodes = _free_runs[count];
+
+    _free_runs[count] = nodes->_child_nodes;
+
+    return nodes;
+  }
+
+  if ((_current_slab < _slabs.size())
+      && (_slab_used + count > _slab_sizes[_current_slab])) {
+    _current_slab++;
+    _slab_used = 0;
+  }
+
+  if (_current_slab == _slabs.size()) {
+    int nodes = _slabs.empty() ? FIRST_SLAB_NODES : _slab_sizes.back() * 2;
+
+    if (nodes > MAX_SLAB_NODES)
+      nodes = MAX_SLAB_NODES;
+
+    _slabs.push_back((wt_node *)::operator new(nodes * sizeof(wt_node)));
+    _slab_sizes.push_back(nodes);
+  }
+
+  wt_node *nodes = _slabs[_current_slab] + _slab_used;
+
+  _slab_used += count;
+
+  return nodes;
+}
+
+/* Keep a run of `count` nodes that's no longer used, for new_nodes to
+ * hand out again. */
+void wordtree::free_nodes(wt_node *nodes, int count)
+{
+  nodes->_child_nodes = _free_runs[count];
+  _free_runs[count] = nodes;
+}
+
+/* Give `node` a new, empty child on `ch`, and return it. The node's
+ * children are moved to a run one longer, with the new child in its
+ * place in letter order. */
+wordtree::wt_node *wordtree::add_child(wt_node *node, char ch)
+{
+  uint32_t bit = 1 << (ch - 'a');
+  int count = __builtin_popcount(node->_children);
+  int before = __builtin_popcount(node->_children & (bit - 1));
+  wt_node *nodes = new_nodes(count + 1);
+
+  for(int i = 0; i < before; i++)
+    nodes[i] = node->_child_nodes[i];
+
+  new(nodes + before) wt_node(ch, false);
+
+  for(int i = before; i < count; i++)
+    nodes[i + 1] = node->_child_nodes[i];
+
+  if (count > 0)
+    free_nodes(node->_child_nodes, count);
+
+  node->_children |= bit;
+  node->_child_nodes = nodes;
+  _node_count++;
+
+  return nodes + before;
+}
 
 void wordtree::insert_word(char *new_word)
 {
@@ -26,14 +121,12 @@ void wordtree::insert_word(char *new_word)
 
   while (*current_char != '\0') {
     if (*current_char >= 'a' && *current_char <= 'z') { 
+      wt_node *next_node = current_node->child(*current_char);
 
-      if (current_node->_child_node[*current_char - 'a'] == NULL)
-	current_node->_child_node[*current_char - 'a'] = 
-	  new wt_node(*current_char, false);
-      
-      current_node = current_node->_child_node[*current_char - 'a'];
+      if (next_node == NULL)
+        next_node = add_child(current_node, *current_char);
 
-      assert(current_node);
+      current_node = next_node;
     }
 
     current_char++;
@@ -48,10 +141,15 @@ void wordtree::delete_word(char *target_word) {
   char *current_char = target_word;
 
   while (*current_char != '\0') {
-    current_node = current_node->_child_node[*current_char - 'a'];
-    current_char++;
+    if (*current_char >= 'a' && *current_char <= 'z') {
+      current_node = current_node->child(*current_char);
+
+      // The word isn't in the tree, so there's nothing to delete.
+      if (current_node == NULL)
+        return;
+    }
 
-    assert(current_node);
+    current_char++;
   }
 
   current_node->_is_word = false;
@@ -75,6 +173,64 @@ void wordtree::delete_words(iterator i)
       delete_words(i.letter(ch));
 }
 
+/* Ensure that all words in `wt` are marked as valid words. */
+void wordtree::insert_words(wordtree &wt) {
+  insert_words(iterator(wt));
+};
+
+/* Ensure that all words traversed by iterator i are marked as valid
+ * words. */
+void wordtree::insert_words(iterator i)
+{
+  if (i.is_word())
+    insert_word(i());
+
+  for(char ch = 'a'; ch <= 'z'; ch++)
+    if (i.letter_exists(ch))
+      insert_words(i.letter(ch));
+}
+
+/* Remove every word from the tree. The slabs are kept, so refilling
+ * the tree reuses their memory. */
+void wordtree::clear()
+{
+  _node._children = 0;
+  _node._child_nodes = NULL;
+  _node._is_word = false;
+
+  _current_slab = 0;
+  _slab_used = 0;
+
+  for(int i = 0; i <= 26; i++)
+    _free_runs[i] = NULL;
+
+  _node_count = 0;
+}
+
+/* Return the number of nodes in the tree, not counting the root. */
+int wordtree::node_count()
+{
+  return _node_count;
+}
+
+/* Return the number of words in the tree. This walks the whole
+ * tree. */
+int wordtree::word_count()
+{
+  return word_count(iterator(*this));
+}
+
+int wordtree::word_count(iterator i)
+{
+  int words = i.is_word() ? 1 : 0;
+
+  for(char ch = 'a'; ch <= 'z'; ch++)
+    if (i.letter_exists(ch))
+      words += word_count(i.letter(ch));
+
+  return words;
+}
+
 /* Dump the tree structure for debugging purposes. */
 void wordtree::dump() {
   _node.dump();
@@ -101,6 +257,16 @@ wordtree::iterator::iterator(wordtree &wt, char *prefix)
   initialize_prefix(prefix);
 }
 
+/* Create a new traversal iterator rooted at the base of a version of
+ * a word_versions, using the specified string as a prefix. The
+ * version must stay entered while the iterator is in use. */
+wordtree::iterator::iterator(word_version &version, char *prefix)
+{
+  _current_node = &version._root;
+
+  initialize_prefix(prefix);
+}
+
 /* Create a new traversal iterator rooted at the passed wt_node, and
  * using the specified string as a prefix.
  */
@@ -140,11 +306,18 @@ void wordtree::iterator::initialize_prefix(char *prefix)
 bool wordtree::iterator::letter_exists(char letter)
 {
   if (letter >= 'a' && letter <= 'z')
-    return (_current_node->_child_node[letter - 'a']) != NULL;
+    return (_current_node->_children & (1 << (letter - 'a'))) != 0;
 
   return false;
 }
 
+/* Return the letters that continue the prefix, as bits, with 'a' as
+ * bit 0. */
+uint32_t wordtree::iterator::letters()
+{
+  return _current_node->_children;
+}
+
 /* Determine if the iterator represents a traversal of a valid word. */
 bool wordtree::iterator::is_word()
 {
@@ -164,21 +337,15 @@ wordtree::iterator wordtree::iterator::letter(char letter)
 {
   assert(letter_exists(letter));
 
-  return iterator(_current_node->_child_node[letter - 'a'], _prefix);
+  return iterator(_current_node->child(letter), _prefix);
 }
 
 wordtree::wt_node::wt_node(char ch, bool is_word /* = FALSE */)
 {
   _ch = ch;
   _is_word = is_word;
-
-  for(char ch = 'a'; ch <= 'z'; ch++)
-    _child_node[ch - 'a'] = NULL;
-};
-
-wordtree::wt_node::~wt_node() {
-  for(char ch = 'a'; ch <= 'z'; ch++)
-    delete _child_node[ch - 'a'];
+  _children = 0;
+  _child_nodes = NULL;
 };
 
 /* Make a dump of the structure of the tree for debugging purposes,
@@ -191,14 +358,278 @@ void wordtree::wt_node::dump() {
     cout << this << "  (";
 
   for(char ch = 'a'; ch <= 'z'; ch++)
-    if (_child_node[ch - 'a'] != NULL)
-      cout << ch << ", " << _child_node[ch - 'a'] << "; ";
+    if (child(ch) != NULL)
+      cout << ch << ", " << child(ch) << "; ";
 
   cout << ")" << endl;
 
   for(char ch = 'a'; ch <= 'z'; ch++)
-    if (_child_node[ch - 'a'] != NULL) 
-      _child_node[ch - 'a']->dump();
+    if (child(ch) != NULL)
+      child(ch)->dump();
+}
+
+uint64_t word_version::number()
+{
+  return _number;
+}
+
+/* Take over `words` as the first version, for `readers` threads to
+ * search. From then on, the nodes of `words` belong to the versions,
+ * and it must not be used except to be destroyed, which it must not
+ * be before the word_versions is.
+ */
+word_versions::word_versions(wordtree &words, int readers)
+  : _words(words)
+{
+  word_version *first = new word_version;
+
+  first->_root = words._node;
+  first->_number = 1;
+  first->_retired_at = 0;
+
+  _readers = readers;
+  _pins = new std::atomic<uint64_t>[readers];
+
+  for(int i = 0; i < readers; i++)
+    _pins[i] = IDLE;
+
+  _epoch = IDLE + 1;
+  _current = first;
+}
+
+word_versions::~word_versions()
+{
+  while (!_retired.empty()) {
+    delete _retired.front();
+    _retired.pop_front();
+  }
+
+  delete _current.load();
+  delete [] _pins;
+}
+
+/* Return the current version for `reader` to search, until it calls
+ * leave(). */
+word_version *word_versions::enter(int reader)
+{
+  _pins[reader] = _epoch.load();
+
+  return _current.load();
+}
+
+void word_versions::leave(int reader)
+{
+  _pins[reader] = IDLE;
+}
+
+/* Publish a version with the words in `added` added, and then those in
+ * `removed` removed, returning its number. Removing a word only
+ * unmarks it, as delete_word does, so its nodes stay. */
+uint64_t word_versions::update(wordtree &added, wordtree &removed)
+{
+  std::unique_lock<std::mutex> guard(_update_lock);
+
+  return apply(added, removed);
+}
+
+/* Publish a version holding exactly the words in `words`, such as a
+ * fresh copy of the dictionary, returning its number. Only the words
+ * that differ from the current version are changed. */
+uint64_t word_versions::replace(wordtree &words)
+{
+  std::unique_lock<std::mutex> guard(_update_lock);
+  word_version *last = _current.load();
+  wordtree added, removed;
+
+  difference(wordtree::iterator(*last), wordtree::iterator(words), removed);
+  difference(wordtree::iterator(words), wordtree::iterator(*last), added);
+
+  return apply(added, removed);
+}
+
+/* Make and publish the version for update(), with _update_lock
+ * held. */
+uint64_t word_versions::apply(wordtree &added, wordtree &removed)
+{
+  word_version *last = _current.load();
+  word_version *version = new word_version;
+
+  version->_root = last->_root;
+  version->_number = last->_number + 1;
+  version->_retired_at = 0;
+
+  insert_words(last, version, wordtree::iterator(added));
+  remove_words(last, version, wordtree::iterator(removed));
+
+  _fresh.clear();
+
+  publish(version);
+
+  return version->_number;
+}
+
+/* Add the words below `a` that aren't below `b` to `only_a`. */
+void word_versions::difference(wordtree::iterator a, wordtree::iterator b,
+                               wordtree &only_a)
+{
+  if (a.is_word() && !b.is_word())
+    only_a.insert_word(a());
+
+  for(char ch = 'a'; ch <= 'z'; ch++)
+    if (a.letter_exists(ch)) {
+      if (b.letter_exists(ch))
+        difference(a.letter(ch), b.letter(ch), only_a);
+      else
+        only_a.insert_words(a.letter(ch));
+    }
+}
+
+/* Return the node for `word` in `version`, or NULL if there's none. */
+wordtree::wt_node *word_versions::find(word_version *version, const char *word)
+{
+  wt_node *node = &version->_root;
+
+  for(const char *ch = word; (*ch != '\0') && (node != NULL); ch++)
+    if (*ch >= 'a' && *ch <= 'z')
+      node = node->child(*ch);
+
+  return node;
+}
+
+/* Return the node for `word` in `version`, which is being built from
+ * `last`, adding nodes to reach it if need be. Each run of children
+ * on the way that's still shared with `last` is copied first, so that
+ * the node returned, and the path to it, can be changed without
+ * changing `last`.
+ */
+wordtree::wt_node *word_versions::copy_path(word_version *last,
+                                            word_version *version,
+                                            const char *word)
+{
+  wt_node *node = &version->_root;
+
+  for(const char *ch = word; *ch != '\0'; ch++) {
+    if ((*ch < 'a') || (*ch > 'z'))
+      continue;
+
+    uint32_t bit = 1 << (*ch - 'a');
+    int count = __builtin_popcount(node->_children);
+    int index = __builtin_popcount(node->_children & (bit - 1));
+    wt_node *run = node->_child_nodes;
+
+    if (!(node->_children & bit)) {
+      run = _words.new_nodes(count + 1);
+
+      for(int i = 0; i < index; i++)
+        run[i] = node->_child_nodes[i];
+
+      new(run + index) wt_node(*ch, false);
+
+      for(int i = index; i < count; i++)
+        run[i + 1] = node->_child_nodes[i];
+
+      if (count > 0)
+        release_run(last, node->_child_nodes, count);
+
+      node->_children |= bit;
+      _words._node_count++;
+      _fresh.insert(run);
+
+    } else if (_fresh.find(run) == _fresh.end()) {
+      run = _words.new_nodes(count);
+
+      for(int i = 0; i < count; i++)
+        run[i] = node->_child_nodes[i];
+
+      release_run(last, node->_child_nodes, count);
+      _fresh.insert(run);
+    }
+
+    node->_child_nodes = run;
+    node = run + index;
+  }
+
+  return node;
+}
+
+/* Stop using `run`, of `count` nodes. A run made by this change was
+ * never published, so it can be reused at once; any other is still in
+ * `last`, and is kept until `last` is retired. */
+void word_versions::release_run(word_version *last, wt_node *run, int count)
+{
+  if (_fresh.erase(run) > 0)
+    _words.free_nodes(run, count);
+  else
+    last->_replaced.push_back(std::make_pair(run, count));
+}
+
+void word_versions::insert_words(word_version *last, word_version *version,
+                                 wordtree::iterator i)
+{
+  if (i.is_word()) {
+    wt_node *node = find(version, i());
+
+    if ((node == NULL) || !node->_is_word)
+      copy_path(last, version, i())->_is_word = true;
+  }
+
+  for(char ch = 'a'; ch <= 'z'; ch++)
+    if (i.letter_exists(ch))
+      insert_words(last, version, i.letter(ch));
+}
+
+void word_versions::remove_words(word_version *last, word_version *version,
+                                 wordtree::iterator i)
+{
+  if (i.is_word()) {
+    wt_node *node = find(version, i());
+
+    if ((node != NULL) && node->_is_word)
+      copy_path(last, version, i())->_is_word = false;
+  }
+
+  for(char ch = 'a'; ch <= 'z'; ch++)
+    if (i.letter_exists(ch))
+      remove_words(last, version, i.letter(ch));
+}
+
+/* Make `version` the current version, and retire the one it replaces.
+ * The epoch moves on once the new version is in place, so any reader
+ * that enters in a later epoch can only find the new version. */
+void word_versions::publish(word_version *version)
+{
+  word_version *last = _current.exchange(version);
+
+  last->_retired_at = _epoch.fetch_add(1);
+  _retired.push_back(last);
+
+  reclaim();
+}
+
+/* Free the runs of every retired version that no reader can still be
+ * searching: those retired before the epoch of the earliest reader
+ * still searching, or all of them, if none are. */
+void word_versions::reclaim()
+{
+  uint64_t earliest = UINT64_MAX;
+
+  for(int i = 0; i < _readers; i++) {
+    uint64_t pin = _pins[i].load();
+
+    if ((pin != IDLE) && (pin < earliest))
+      earliest = pin;
+  }
+
+  while (!_retired.empty() && (_retired.front()->_retired_at < earliest)) {
+    word_version *version = _retired.front();
+
+    for(size_t i = 0; i < version->_replaced.size(); i++)
+      _words.free_nodes(version->_replaced[i].first,
+                        version->_replaced[i].second);
+
+    delete version;
+    _retired.pop_front();
+  }
 }
 
 /* Print each word in a wordtree on the passed output stream.
@@ -215,33 +646,45 @@ ostream &operator<<(ostream &o, wordtree &wt)
      return o;
 }
 
-/* Load a list of words, delimtied with braces, into a wordtree. */
+/* Read a word list in braces, one word per run of letters. Words too
+ * long to ever be found on a board are skipped. Any other character,
+ * or the end of the stream before the closing brace, is a parse
+ * error. */
 istream &operator>>(istream &i, wordtree &wt)
 {
   char word_buf[MAX_WORD_SIZE];
-  char ch = '\0';
+  int ch;
   int index;
 
   skip_whitespace(i);
   if (!expect(i, '{')) goto failed_read;
 
-  while(ch != '}') {
+  for(;;) {
     skip_whitespace(i);
-    i.get(ch);
+    ch = i.get();
+
+    if (ch == '}')
+      break;
 
     index = 0;
     while((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z')) {
-      word_buf[index] = ch;
+      if (index < MAX_WORD_SIZE - 1)
+        word_buf[index] = tolower(ch);
       index++;
 
-      i.get(ch);
+      ch = i.get();
     }
 
-    i.putback(ch);
-    word_buf[index] = '\0';
+    if (index == 0)
+      goto failed_read;
 
-    if (index > 0)
-         wt.insert_word(word_buf);
+    if (ch != EOF)
+      i.putback(ch);
+
+    if (index < MAX_WORD_SIZE) {
+      word_buf[index] = '\0';
+      wt.insert_word(word_buf);
+    }
   }
 
   return i;
@@ -251,3 +694,45 @@ failed_read:
   return i;
 };
 
+/* Read a word list from a scanner. Besides the brace delimited form
+ * read from an istream, this also accepts a plain list of words, one
+ * per line, running to the end of the input. Words too long to ever
+ * be found on a board are skipped, with a warning. */
+scanner &operator>>(scanner &s, wordtree &wt)
+{
+  char word_buf[MAX_WORD_SIZE];
+  int too_long = 0;
+  bool braced;
+
+  s.skip_whitespace();
+  braced = s.expect('{');
+
+  for(;;) {
+    s.skip_whitespace();
+
+    if (braced && s.expect('}'))
+      break;
+
+    int length = s.read_word(word_buf, MAX_WORD_SIZE);
+
+    if (length < 0) {
+      too_long++;
+      continue;
+    }
+
+    if (length > 0) {
+      wt.insert_word(word_buf);
+      continue;
+    }
+
+    if (braced || (s.peek() != EOF))
+      s.set_fail();
+
+    break;
+  }
+
+  if (too_long > 0)
+    warn("Skipped words too long to fit on a board.");
+
+  return s;
+}
@@ -16,24 +16,52 @@
 #ifndef WORDTREE_H
 #define WORDTREE_H
 
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+class scanner;
+class word_version;
+
+/* A wordtree is a trie of words. Each node keeps the letters it has
+ * children for as bits, and the children themselves side by side in
+ * letter order, so a child is found by counting the bits below its
+ * letter. The runs of children are carved out of slabs owned by the
+ * tree, rather than being allocated one at a time. A run that's
+ * outgrown by an insert is kept for reuse by another run of the same
+ * length. Destroying or clearing a tree releases all of its nodes at
+ * once. */
 class wordtree {
 private:
   struct wt_node; 
 
 public:
+  wordtree();
+  ~wordtree();
+
   void insert_word(char *new_word);
   void delete_word(char *new_word);
   void delete_words(wordtree &old_words);
+  void insert_words(wordtree &new_words);
+  void clear();
   void dump();
 
+  int node_count();
+  int word_count();
+
   class iterator {
   public:
     iterator(wordtree &wt, char *prefix = NULL);
+    iterator(word_version &version, char *prefix = NULL);
 
     char *operator()();
 
     bool letter_exists(char letter);
     bool is_word();
+    uint32_t letters();
 
     iterator letter(char letter);
 
@@ -48,24 +76,151 @@ public:
 private:
   struct wt_node {
     wt_node(char ch = '\0', bool is_word = false);
-    ~wt_node();
     void dump();
 
+    wt_node *child(char letter);
+
     char _ch;
     bool _is_word;
-    wt_node *_child_node[26];
+    uint32_t _children;        // The letters with children, as bits
+    wt_node *_child_nodes;     // The children, in letter order. A
+                               // free run links to the next with this.
   };
 
   friend ostream &operator<<(ostream &o, wordtree &wt);
+  friend class word_version;
+  friend class word_versions;
 
   void print(ostream &o, iterator i);
 
   void delete_words(iterator old_words);
+  void insert_words(iterator new_words);
+  int word_count(iterator i);
+
+  wordtree(const wordtree &);
+  wordtree &operator=(const wordtree &);
+
+  wt_node *add_child(wt_node *node, char ch);
+  wt_node *new_nodes(int count);
+  void free_nodes(wt_node *nodes, int count);
+
+  /* Slabs start small, so that small trees stay small, and double in
+   * size up to a limit. */
+  static const int FIRST_SLAB_NODES = 64;
+  static const int MAX_SLAB_NODES = 65536;
+
+  std::vector<wt_node *> _slabs;
+  std::vector<int> _slab_sizes;
+  size_t _current_slab;      // The slab new nodes are taken from
+  int _slab_used;            // The nodes used so far in that slab
+  wt_node *_free_runs[27];   // Outgrown runs of children, by length
+  int _node_count;
+
   wt_node _node;
 };  
 
+/* One version of the words in a word_versions. A version never
+ * changes once it's published, so any number of threads may search it
+ * at once. It can be searched as a wordtree, through its iterator. */
+class word_version {
+public:
+  typedef wordtree::iterator iterator;
+
+  uint64_t number();
+
+private:
+  friend class wordtree::iterator;
+  friend class word_versions;
+
+  wordtree::wt_node _root;
+  uint64_t _number;
+  uint64_t _retired_at;            // The epoch it was replaced in
+  std::vector<std::pair<wordtree::wt_node *, int> > _replaced;
+                                   // Runs only it uses, and their lengths
+};
+
+/* A word_versions lets words be added to and removed from a
+ * dictionary while other threads are searching it.
+ *
+ * Readers never see a change being made. Each change is made to a new
+ * version, which is then published by swapping a single pointer, so a
+ * reader sees either all of a change or none of it, and a reader part
+ * way through a search keeps the version it started with. Versions
+ * share all the nodes they have in common: a change copies only the
+ * runs of children on the paths to the words it changes, so adding a
+ * hundred words copies a few hundred runs, however big the
+ * dictionary.
+ *
+ * The runs a change replaced are freed once no reader can still be
+ * using the old version. Readers note the epoch they entered in, and
+ * each version replaced is stamped with the epoch it was replaced in,
+ * so a version is free to go once every reader still searching
+ * entered after that. Readers are numbered, one for each thread
+ * that searches, and a reader may only be in one version at a time.
+ * Changes are made one at a time.
+ */
+class word_versions {
+public:
+  word_versions(wordtree &words, int readers);
+  ~word_versions();
+
+  word_version *enter(int reader);
+  void leave(int reader);
+
+  uint64_t update(wordtree &added, wordtree &removed);
+  uint64_t replace(wordtree &words);
+
+private:
+  typedef wordtree::wt_node wt_node;
+
+  static const uint64_t IDLE = 0;   // The epoch of a reader not searching
+
+  word_versions(const word_versions &);
+  word_versions &operator=(const word_versions &);
+
+  uint64_t apply(wordtree &added, wordtree &removed);
+  wt_node *find(word_version *version, const char *word);
+  wt_node *copy_path(word_version *last, word_version *version,
+                     const char *word);
+  void release_run(word_version *last, wt_node *run, int count);
+
+  void insert_words(word_version *last, word_version *version,
+                    wordtree::iterator i);
+  void remove_words(word_version *last, word_version *version,
+                    wordtree::iterator i);
+  void difference(wordtree::iterator a, wordtree::iterator b,
+                  wordtree &only_a);
+
+  void publish(word_version *version);
+  void reclaim();
+
+  wordtree &_words;                // Where every version's nodes live
+  int _readers;
+
+  std::atomic<word_version *> _current;
+  std::atomic<uint64_t> _epoch;
+  std::atomic<uint64_t> *_pins;    // The epoch each reader entered in
+
+  std::mutex _update_lock;         // Held while making a change
+  std::deque<word_version *> _retired;
+  std::unordered_set<wt_node *> _fresh; // Runs made by this change
+};
+
+/* Return the child on `letter`, 'a' to 'z', or NULL if there isn't
+ * one. */
+inline wordtree::wt_node *wordtree::wt_node::child(char letter)
+{
+  uint32_t bit = 1 << (letter - 'a');
+
+  if (!(_children & bit))
+    return NULL;
+
+  return _child_nodes + __builtin_popcount(_children & (bit - 1));
+}
+
 ostream &operator<<(ostream &o, wordtree &wt);
 istream &operator>>(istream &i, wordtree &wt);
+scanner &operator>>(scanner &s, wordtree &wt);
 
 #endif
 